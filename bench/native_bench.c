@@ -0,0 +1,178 @@
+// Microbenchmarks for natives, called straight through their cc_function_*
+// entry points with no compiler or interpreter in the way.  Build from the
+// repository root with everything but main.c:
+//
+//   tcc -lm -lpthread -Wall -g -o bin/native_bench bench/native_bench.c $(ls src/*.c | grep -v main.c) src/ext/*.c
+//
+//   bin/native_bench [name filter]
+//
+// Every case runs at each of the sizes in benchSizes until it has taken
+// BENCH_MIN_NS or allocated BENCH_MAX_BYTES, whichever comes first.  Nothing
+// is freed until the VM is, so the byte limit keeps big cases from eating all
+// the memory.  Reports nanoseconds and bytes allocated per call.
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/common.h"
+#include "../src/memory.h"
+#include "../src/object.h"
+#include "../src/vm.h"
+#include "../src/ext/ferrors.h"
+#include "../src/ext/string.h"
+#include "../src/ext/userarray.h"
+
+#define BENCH_MIN_NS 200000000
+#define BENCH_MAX_BYTES (256 * 1024 * 1024)
+
+static const int benchSizes[] = { 16, 256, 4096, 65536, 1048576 };
+
+// Fills args with inputs of roughly the given size, returning how many.
+typedef int (*BenchSetup)(int size, Value* args);
+
+typedef struct {
+  const char* name;
+  BenchSetup setup;
+  NativeFn function;
+} BenchCase;
+
+
+static uint64_t now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (uint64_t)time.tv_sec * 1000000000u + (uint64_t)time.tv_nsec;
+}
+
+
+static Value repeatedString(const char* piece, int size) {
+  int pieceLength = (int)strlen(piece);
+  char* chars = ALLOCATE(char, size + 1);
+  for (int i = 0; i < size; i++) {
+    chars[i] = piece[i % pieceLength];
+  }
+  chars[size] = '\0';
+  return OBJ_VAL(takeString(chars, size));
+}
+
+
+static Value cString(const char* chars) {
+  return OBJ_VAL(copyString(chars, (int)strlen(chars)));
+}
+
+
+// Comma separated five letter words.
+static int setupStringSplit(int size, Value* args) {
+  args[0] = repeatedString("word,", size);
+  args[1] = cString(",");
+  return 2;
+}
+
+
+// The needle only shows up at the very end, and its first character is
+// everywhere before that.
+static int setupStringIndexOf(int size, Value* args) {
+  char* chars = ALLOCATE(char, size + 1);
+  memset(chars, 'a', size);
+  chars[size - 1] = 'b';
+  chars[size] = '\0';
+  args[0] = OBJ_VAL(takeString(chars, size));
+  args[1] = cString("ab");
+  return 2;
+}
+
+
+// Whitespace on both ends, a quarter of the string each.
+static int setupStringTrim(int size, Value* args) {
+  char* chars = ALLOCATE(char, size + 1);
+  memset(chars, ' ', size);
+  memset(chars + size / 4, 'x', size / 2);
+  chars[size] = '\0';
+  args[0] = OBJ_VAL(takeString(chars, size));
+  return 1;
+}
+
+
+static int setupArrayJoin(int size, Value* args) {
+  ObjUserArray* ua = newUserArray();
+  ua_grow(ua, size);
+  char item[32];
+  for (int i = 0; i < size; i++) {
+    snprintf(item, sizeof(item), "item%d", i);
+    ua->inner.values[ua->inner.count++] = cString(item);
+  }
+  args[0] = OBJ_VAL(ua);
+  args[1] = cString(", ");
+  return 2;
+}
+
+
+// Park-Miller pseudo-random numbers, the same every run.
+static int setupArraySort(int size, Value* args) {
+  ObjUserArray* ua = newUserArray();
+  ua_grow(ua, size);
+  uint64_t seed = 42;
+  for (int i = 0; i < size; i++) {
+    seed = seed * 16807 % 2147483647;
+    ua->inner.values[ua->inner.count++] = NUMBER_VAL((double)seed);
+  }
+  args[0] = OBJ_VAL(ua);
+  return 1;
+}
+
+
+static BenchCase benchCases[] = {
+  { "string_split",    setupStringSplit,   cc_function_string_split },
+  { "string_index_of", setupStringIndexOf, cc_function_string_index_of },
+  { "string_trim",     setupStringTrim,    cc_function_string_trim },
+  { "ar_join",         setupArrayJoin,     cc_function_ar_join },
+  { "ar_sort",         setupArraySort,     cc_function_ar_sort },
+};
+
+
+static void runCase(BenchCase* bench, int size) {
+  Value args[4];
+  int argCount = bench->setup(size, args);
+
+  // One untimed call to warm up the caches and the string table, and to make
+  // sure the inputs are acceptable.
+  Value result = bench->function(argCount, args);
+  if (IS_FERROR(result)) {
+    printf("%-16s %8d  %s\n", bench->name, size,
+           cc_ferror_to_string(AS_FERROR(result)->ferror_id));
+    return;
+  }
+
+  size_t bytesBefore = memoryStats.bytesAllocated;
+  uint64_t start = now();
+  uint64_t elapsed;
+  long iterations = 0;
+  do {
+    bench->function(argCount, args);
+    iterations++;
+    elapsed = now() - start;
+  } while (elapsed < BENCH_MIN_NS &&
+           memoryStats.bytesAllocated - bytesBefore < BENCH_MAX_BYTES);
+
+  printf("%-16s %8d %10ld %14.1f %14.1f\n", bench->name, size, iterations,
+         (double)elapsed / iterations,
+         (double)(memoryStats.bytesAllocated - bytesBefore) / iterations);
+}
+
+
+int main(int argc, const char* argv[]) {
+  const char* filter = argc > 1 ? argv[1] : NULL;
+
+  initVM();
+
+  printf("%-16s %8s %10s %14s %14s\n", "native", "size", "calls", "ns/call", "bytes/call");
+  for (size_t i = 0; i < sizeof(benchCases) / sizeof(benchCases[0]); i++) {
+    if (filter != NULL && strstr(benchCases[i].name, filter) == NULL) continue;
+    for (size_t j = 0; j < sizeof(benchSizes) / sizeof(benchSizes[0]); j++) {
+      runCase(&benchCases[i], benchSizes[j]);
+    }
+  }
+
+  freeVM();
+  return 0;
+}
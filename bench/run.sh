@@ -0,0 +1,142 @@
+#!/bin/sh
+#
+# Runs the benchmark corpus in bench/ and reports wall time, instructions
+# executed and peak RSS for each script.
+#
+#   bench/run.sh [-n runs] [-c clox] [-s stats_clox] [-o results] [-b baseline]
+#                [-t percent] [benchmark ...]
+#
+#   -n  timed runs per benchmark, after one untimed warm-up run (default 5)
+#   -c  the interpreter to time (default bin/clox)
+#   -s  an interpreter built with -DDEBUG_OPCODE_STATS, run once per benchmark
+#       to count instructions
+#   -o  save the results here, to use as a baseline later
+#   -b  compare medians against a saved baseline and exit 1 on a regression
+#   -t  how many percent slower counts as a regression (default 5)
+#
+# Benchmarks are named by file, without the .lox.  All of them run by default.
+# Peak RSS needs GNU time at /usr/bin/time.
+
+runs=5
+clox=bin/clox
+stats_clox=
+save=
+baseline=
+threshold=5
+
+while getopts "n:c:s:o:b:t:h" opt; do
+  case $opt in
+    n) runs=$OPTARG ;;
+    c) clox=$OPTARG ;;
+    s) stats_clox=$OPTARG ;;
+    o) save=$OPTARG ;;
+    b) baseline=$OPTARG ;;
+    t) threshold=$OPTARG ;;
+    *) sed -n '3,17s/^# \{0,1\}//p' "$0"; exit 64 ;;
+  esac
+done
+shift $((OPTIND - 1))
+
+# Paths given on the command line are relative to where we were started, but
+# the benchmarks transclude relative to the repository root.
+absolute() {
+  case $1 in
+    /*) echo "$1" ;;
+    */*) echo "$(pwd)/$1" ;;
+    *) echo "$1" ;;
+  esac
+}
+clox=$(absolute "$clox")
+[ -n "$stats_clox" ] && stats_clox=$(absolute "$stats_clox")
+[ -n "$save" ] && save=$(absolute "$save")
+[ -n "$baseline" ] && baseline=$(absolute "$baseline")
+
+cd "$(dirname "$0")/.." || exit 1
+
+if [ $# -eq 0 ]; then
+  set -- $(ls bench/*.lox | sed 's|bench/||; s|\.lox$||')
+fi
+
+gnu_time=
+if [ -x /usr/bin/time ] && /usr/bin/time -f %M -o /dev/null true 2>/dev/null; then
+  gnu_time=/usr/bin/time
+fi
+
+tmp=$(mktemp -d) || exit 1
+trap 'rm -rf "$tmp"' EXIT
+status=0
+
+printf '%-14s %9s %9s %9s %14s %10s\n' benchmark median p90 min instructions peak_kb
+echo "# benchmark median_s p90_s min_s instructions peak_rss_kb" > "$tmp/results"
+
+for name in "$@"; do
+  script=bench/$name.lox
+  if [ ! -f "$script" ]; then
+    echo "$name: no such benchmark" >&2
+    status=1
+    continue
+  fi
+
+  # The warm-up run also makes sure the benchmark works at all.
+  if ! "$clox" "$script" > "$tmp/output" 2>&1; then
+    echo "$name: failed" >&2
+    cat "$tmp/output" >&2
+    status=1
+    continue
+  fi
+
+  : > "$tmp/times"
+  rss=-
+  i=0
+  while [ $i -lt "$runs" ]; do
+    start=$(date +%s%N)
+    if [ -n "$gnu_time" ]; then
+      $gnu_time -f %M -o "$tmp/rss" "$clox" "$script" > /dev/null 2>&1
+      run_rss=$(tail -n 1 "$tmp/rss")
+      if [ "$rss" = - ] || [ "$run_rss" -gt "$rss" ]; then
+        rss=$run_rss
+      fi
+    else
+      "$clox" "$script" > /dev/null 2>&1
+    fi
+    end=$(date +%s%N)
+    echo $(((end - start) / 1000)) >> "$tmp/times"
+    i=$((i + 1))
+  done
+
+  instructions=-
+  if [ -n "$stats_clox" ]; then
+    CLOX_OPCODE_STATS=$tmp/stats.json "$stats_clox" "$script" > /dev/null 2>&1
+    instructions=$(sed -n 's/.*"instructions": \([0-9]*\).*/\1/p' "$tmp/stats.json")
+    rm -f "$tmp/stats.json"
+  fi
+
+  sort -n "$tmp/times" | awk -v name="$name" -v insns="${instructions:--}" -v rss="$rss" '
+    { t[NR] = $1 / 1000000 }
+    END {
+      median = NR % 2 ? t[(NR + 1) / 2] : (t[NR / 2] + t[NR / 2 + 1]) / 2
+      p90 = int(NR * 0.9); if (p90 < NR * 0.9) p90++
+      printf "%s %.4f %.4f %.4f %s %s\n", name, median, t[p90], t[1], insns, rss
+    }' >> "$tmp/results"
+  tail -n 1 "$tmp/results" | awk '{ printf "%-14s %8.4fs %8.4fs %8.4fs %14s %10s\n", $1, $2, $3, $4, $5, $6 }'
+done
+
+[ -n "$save" ] && cp "$tmp/results" "$save"
+
+if [ -n "$baseline" ]; then
+  echo
+  printf '%-14s %9s %9s %8s\n' benchmark baseline median change
+  awk -v threshold="$threshold" '
+    /^#/ { next }
+    FNR == NR { base[$1] = $2; next }
+    !($1 in base) { printf "%-14s %9s %8.4fs\n", $1, "-", $2; next }
+    {
+      change = base[$1] > 0 ? ($2 - base[$1]) / base[$1] * 100 : 0
+      flag = change > threshold ? "  REGRESSION" : ""
+      if (flag != "") regressions++
+      printf "%-14s %8.4fs %8.4fs %+7.1f%%%s\n", $1, base[$1], $2, change, flag
+    }
+    END { exit regressions > 0 }' "$baseline" "$tmp/results" || status=1
+fi
+
+exit $status
@@ -1,5 +1,7 @@
 #!/bin/sh
 
-tcc -lm -Wall -g -o bin/clox src/*.c src/ext/*.c
-#clang -lm -Wall -g -o bin/clox src/*.c src/ext/*.c
-#clang -lm -Wall -O3 -o bin/clox src/*.c src/ext/*.c
+tcc -lm -lpthread -Wall -g -o bin/clox src/*.c src/ext/*.c
+#clang -lm -lpthread -Wall -g -o bin/clox src/*.c src/ext/*.c
+#clang -lm -lpthread -Wall -O3 -o bin/clox src/*.c src/ext/*.c
+#clang -lm -lpthread -Wall -O3 -DCC_JIT -o bin/clox src/*.c src/ext/*.c
+#tcc -lm -lpthread -Wall -g -o bin/native_bench bench/native_bench.c $(ls src/*.c | grep -v main.c) src/ext/*.c
@@ -29,11 +29,34 @@ typedef enum {
     OP_JUMP_IF_FALSE,
     OP_LOOP,
     OP_CALL,
+    // Emitted in place of OP_CALL when the call is the whole of a return
+    // statement's value.  Calls to Lox functions reuse the current CallFrame.
+    OP_TAIL_CALL,
     OP_RETURN,
+    // Number-only variants of the arithmetic and comparison instructions.  The
+    // compiler never emits these.  run() rewrites the generic instruction in
+    // place once it sees two number operands, and rewrites it back if the guard
+    // ever fails.
+    OP_GREATER_NUM,
+    OP_LESS_NUM,
+    OP_ADD_NUM,
+    OP_SUBTRACT_NUM,
+    OP_MULTIPLY_NUM,
+    OP_DIVIDE_NUM,
 #ifdef CC_FEATURES
     OP_EXIT,
     OP_ECHO,
-    OP_TRANSCLUDE
+    OP_TRANSCLUDE,
+    // Calls to the hottest collection natives, emitted by the compiler instead
+    // of OP_GET_GLOBAL + OP_CALL.  Operands are the native's name constant and
+    // the argument count, so run() can fall back to an ordinary call when the
+    // global has been redefined or the arguments don't suit the fast path.
+    // Keep these in the same order as intrinsicNativeNames in vm.c.
+    OP_ARRAY_GET,
+    OP_ARRAY_SET,
+    OP_ARRAY_COUNT,
+    OP_ARRAY_PUSH,
+    OP_HASH_GET
 #endif
 } OpCode;
 
@@ -14,6 +14,15 @@
 
 #define CC_FEATURES
 
+// Build with -DCC_JIT to turn on the baseline JIT in jit.c.  It only knows how
+// to emit x86-64 code for Linux, and needs CC_FEATURES for re-entering run().
+// Compiled code would also bypass the opcode counters.
+#if defined(CC_JIT) && \
+    (!(defined(__x86_64__) && defined(__linux__) && defined(CC_FEATURES)) || \
+     defined(DEBUG_OPCODE_STATS))
+#undef CC_JIT
+#endif
+
 int global_argc;
 const char** global_argv;
 
@@ -70,6 +70,10 @@ typedef struct Compiler {
   Local locals[UINT8_COUNT];
   int localCount;
   int scopeDepth;
+
+  // Offset of the most recently emitted OP_CALL, so returnStatement() can
+  // tell when its value was nothing but a call.
+  int lastCall;
 } Compiler;
 
 
@@ -338,6 +342,7 @@ static void initCompiler(Compiler* compiler, FunctionType type) {
   compiler->type = type;
   compiler->localCount = 0;
   compiler->scopeDepth = 0;
+  compiler->lastCall = -1;
   compiler->function = newFunction();
   current = compiler;
 
@@ -591,6 +596,7 @@ static void call(bool canAssign) {
 #endif
 
   uint8_t argCount = argumentList();
+  current->lastCall = currentChunk()->count;
   emitBytes(OP_CALL, argCount);
 }
 
@@ -750,6 +756,27 @@ static void namedVariable(Token name, bool canAssign) {
     arg = identifierConstant(&name);
     getOp = OP_GET_GLOBAL;
     setOp = OP_SET_GLOBAL;
+
+#ifdef CC_FEATURES
+    // Calls to a handful of hot collection natives get their own opcodes.
+    // Locals were already ruled out above; the VM takes care of the case
+    // where the script later reassigns the global.
+    if (check(TOKEN_LEFT_PAREN)) {
+      int intrinsic = intrinsicOpcode(
+        AS_STRING(currentChunk()->constants.values[arg])
+      );
+      if (intrinsic != -1) {
+        advance();
+        uint8_t argCount = argumentList();
+#ifdef DEBUG_COMPILE_TRACE
+  printf("\t\tbytes = intrinsic, index, argCount\n");
+#endif
+        emitBytes((uint8_t)intrinsic, (uint8_t)arg);
+        emitByte(argCount);
+        return;
+      }
+    }
+#endif
   }
 
   if (canAssign && match(TOKEN_EQUAL)) {
@@ -1103,6 +1130,16 @@ static void returnStatement() {
   } else {
     expression();
     consume(TOKEN_SEMICOLON, "Expect ';' after return value.");
+    // If the last thing the expression did was a call, nothing is left to do
+    // with its result but return it, so the callee can take over our frame.
+    // OP_RETURN still follows for any jumps (and, or) that land past the call.
+    if (current->lastCall != -1 &&
+        current->lastCall == currentChunk()->count - 2) {
+#ifdef DEBUG_COMPILE_TRACE
+  printf("\t\tpatching OP_CALL into OP_TAIL_CALL\n");
+#endif
+      currentChunk()->code[current->lastCall] = OP_TAIL_CALL;
+    }
     emitByte(OP_RETURN);
   }
 }
@@ -60,6 +60,18 @@ static int jumpInstruction(const char* name, int sign, Chunk* chunk, int offset)
 }
 
 
+#ifdef CC_FEATURES
+static int intrinsicInstruction(const char* name, Chunk* chunk, int offset) {
+  uint8_t constant = chunk->code[offset + 1];
+  uint8_t argCount = chunk->code[offset + 2];
+  printf("%-16s C%4d '", name, constant);
+  printValue(chunk->constants.values[constant]);
+  printf("' (%d args)\n", argCount);
+  return offset + 3;
+}
+#endif
+
+
 int disassembleInstruction(Chunk* chunk, int offset) {
   printf("%04d ", offset);
 
@@ -144,9 +156,30 @@ int disassembleInstruction(Chunk* chunk, int offset) {
     case OP_CALL:
       return byteInstruction("OP_CALL", chunk, offset);
 
+    case OP_TAIL_CALL:
+      return byteInstruction("OP_TAIL_CALL", chunk, offset);
+
     case OP_RETURN:
       return simpleInstruction("OP_RETURN", offset);
 
+    case OP_GREATER_NUM:
+      return simpleInstruction("OP_GREATER_NUM", offset);
+
+    case OP_LESS_NUM:
+      return simpleInstruction("OP_LESS_NUM", offset);
+
+    case OP_ADD_NUM:
+      return simpleInstruction("OP_ADD_NUM", offset);
+
+    case OP_SUBTRACT_NUM:
+      return simpleInstruction("OP_SUBTRACT_NUM", offset);
+
+    case OP_MULTIPLY_NUM:
+      return simpleInstruction("OP_MULTIPLY_NUM", offset);
+
+    case OP_DIVIDE_NUM:
+      return simpleInstruction("OP_DIVIDE_NUM", offset);
+
 #ifdef CC_FEATURES
     case OP_EXIT:
       return simpleInstruction("OP_EXIT", offset);
@@ -156,6 +189,21 @@ int disassembleInstruction(Chunk* chunk, int offset) {
 
     case OP_TRANSCLUDE:
       return simpleInstruction("OP_TRANSCLUDE", offset);
+
+    case OP_ARRAY_GET:
+      return intrinsicInstruction("OP_ARRAY_GET", chunk, offset);
+
+    case OP_ARRAY_SET:
+      return intrinsicInstruction("OP_ARRAY_SET", chunk, offset);
+
+    case OP_ARRAY_COUNT:
+      return intrinsicInstruction("OP_ARRAY_COUNT", chunk, offset);
+
+    case OP_ARRAY_PUSH:
+      return intrinsicInstruction("OP_ARRAY_PUSH", chunk, offset);
+
+    case OP_HASH_GET:
+      return intrinsicInstruction("OP_HASH_GET", chunk, offset);
 #endif
 
     default:
@@ -163,3 +211,53 @@ int disassembleInstruction(Chunk* chunk, int offset) {
       return offset + 1;
   }
 }
+
+
+// The name of an opcode, or NULL if it isn't one.
+const char* opcodeName(uint8_t instruction) {
+  switch (instruction) {
+    case OP_CONSTANT: return "OP_CONSTANT";
+    case OP_NIL: return "OP_NIL";
+    case OP_TRUE: return "OP_TRUE";
+    case OP_FALSE: return "OP_FALSE";
+    case OP_POP: return "OP_POP";
+    case OP_GET_LOCAL: return "OP_GET_LOCAL";
+    case OP_SET_LOCAL: return "OP_SET_LOCAL";
+    case OP_GET_GLOBAL: return "OP_GET_GLOBAL";
+    case OP_DEFINE_GLOBAL: return "OP_DEFINE_GLOBAL";
+    case OP_SET_GLOBAL: return "OP_SET_GLOBAL";
+    case OP_EQUAL: return "OP_EQUAL";
+    case OP_GREATER: return "OP_GREATER";
+    case OP_LESS: return "OP_LESS";
+    case OP_ADD: return "OP_ADD";
+    case OP_SUBTRACT: return "OP_SUBTRACT";
+    case OP_MULTIPLY: return "OP_MULTIPLY";
+    case OP_DIVIDE: return "OP_DIVIDE";
+    case OP_NOT: return "OP_NOT";
+    case OP_NEGATE: return "OP_NEGATE";
+    case OP_PRINT: return "OP_PRINT";
+    case OP_JUMP: return "OP_JUMP";
+    case OP_JUMP_IF_FALSE: return "OP_JUMP_IF_FALSE";
+    case OP_LOOP: return "OP_LOOP";
+    case OP_CALL: return "OP_CALL";
+    case OP_TAIL_CALL: return "OP_TAIL_CALL";
+    case OP_RETURN: return "OP_RETURN";
+    case OP_GREATER_NUM: return "OP_GREATER_NUM";
+    case OP_LESS_NUM: return "OP_LESS_NUM";
+    case OP_ADD_NUM: return "OP_ADD_NUM";
+    case OP_SUBTRACT_NUM: return "OP_SUBTRACT_NUM";
+    case OP_MULTIPLY_NUM: return "OP_MULTIPLY_NUM";
+    case OP_DIVIDE_NUM: return "OP_DIVIDE_NUM";
+#ifdef CC_FEATURES
+    case OP_EXIT: return "OP_EXIT";
+    case OP_ECHO: return "OP_ECHO";
+    case OP_TRANSCLUDE: return "OP_TRANSCLUDE";
+    case OP_ARRAY_GET: return "OP_ARRAY_GET";
+    case OP_ARRAY_SET: return "OP_ARRAY_SET";
+    case OP_ARRAY_COUNT: return "OP_ARRAY_COUNT";
+    case OP_ARRAY_PUSH: return "OP_ARRAY_PUSH";
+    case OP_HASH_GET: return "OP_HASH_GET";
+#endif
+    default: return NULL;
+  }
+}
@@ -5,5 +5,6 @@
 
 void disassembleChunk(Chunk* chunk, const char* name);
 int disassembleInstruction(Chunk* chunk, int offset);
+const char* opcodeName(uint8_t instruction);
 
 #endif
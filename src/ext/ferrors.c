@@ -1,27 +1,60 @@
+#include <stdio.h>
+#include <string.h>
+
 #include "ferrors.h"
+#include "../object.h"
 
 const char* ferror_strings[FE_MAX_ERROR_ID] = {
 /*  FE_NONE */                       "(no error)"
 
 /*  FE_INVALID_ARGUMENTS */          ,"invalid function arguments"
 /*  FE_ARG_GTE_1 */                  ,"function takes at least one argument"
+/*  FE_ARG_COUNT_0 */                ,"function takes no arguments"
 /*  FE_ARG_COUNT_1 */                ,"function takes 1 argument"
 /*  FE_ARG_COUNT_2 */                ,"function takes 2 arguments"
 /*  FE_ARG_COUNT_3 */                ,"function takes 3 arguments"
 /*  FE_ARG_COUNT_1_2 */              ,"function takes 1 to 2 arguments"
+/*  FE_ARG_COUNT_0_1 */              ,"function takes at most 1 argument"
 /*  FE_ARG_COUNT_2_3 */              ,"function takes 2 to 3 arguments"
+/*  FE_ARG_COUNT_3_4 */              ,"function takes 3 to 4 arguments"
 /*  FE_ARG_1_STRING */               ,"first argument must be a string"
-/*  FE_ARG_1_FH */                   ,"first argument must be a filehandle"
 /*  FE_ARG_1_NUMBER */               ,"first argument must be a number"
 /*  FE_ARG_1_ARRAY */                ,"first argument must be an array"
+/*  FE_ARG_1_HASH */                 ,"first argument must be a hash"
+/*  FE_ARG_1_FH */                   ,"first argument must be a filehandle"
+/*  FE_ARG_1_FILEMAP */              ,"first argument must be a file map"
+/*  FE_ARG_1_FUNCTION */             ,"first argument must be a function"
 /*  FE_ARG_2_STRING */               ,"second argument must be a string"
 /*  FE_ARG_2_NUMBER */               ,"second argument must be a number"
 /*  FE_ARG_2_ARRAY */                ,"second argument must be an array"
+/*  FE_ARG_2_HASH */                 ,"second argument must be a hash"
+/*  FE_ARG_2_FH */                   ,"second argument must be a filehandle"
+/*  FE_ARG_2_FILEMAP */              ,"second argument must be a file map"
 /*  FE_ARG_2_FUNCTION */             ,"second argument must be a function"
+/*  FE_ARG_3_STRING */               ,"third argument must be a string"
 /*  FE_ARG_3_NUMBER */               ,"third argument must be a number"
 /*  FE_ARG_3_ARRAY */                ,"third argument must be an array"
+/*  FE_ARG_3_HASH */                 ,"third argument must be a hash"
+/*  FE_ARG_3_FH */                   ,"third argument must be a filehandle"
+/*  FE_ARG_3_FILEMAP */              ,"third argument must be a file map"
+/*  FE_ARG_3_FUNCTION */             ,"third argument must be a function"
+/*  FE_ARG_4_STRING */               ,"fourth argument must be a string"
+/*  FE_ARG_4_NUMBER */               ,"fourth argument must be a number"
+/*  FE_ARG_4_ARRAY */                ,"fourth argument must be an array"
+/*  FE_ARG_4_HASH */                 ,"fourth argument must be a hash"
+/*  FE_ARG_4_FH */                   ,"fourth argument must be a filehandle"
+/*  FE_ARG_4_FILEMAP */              ,"fourth argument must be a file map"
+/*  FE_ARG_4_FUNCTION */             ,"fourth argument must be a function"
+/*  FE_ARG_N_STRING */               ,"an argument after the fourth must be a string"
+/*  FE_ARG_N_NUMBER */               ,"an argument after the fourth must be a number"
+/*  FE_ARG_N_ARRAY */                ,"an argument after the fourth must be an array"
+/*  FE_ARG_N_HASH */                 ,"an argument after the fourth must be a hash"
+/*  FE_ARG_N_FH */                   ,"an argument after the fourth must be a filehandle"
+/*  FE_ARG_N_FILEMAP */              ,"an argument after the fourth must be a file map"
+/*  FE_ARG_N_FUNCTION */             ,"an argument after the fourth must be a function"
 
 /*  FE_STRING_SPLIT_NEGATIVE_LIMIT */,"limit must be positive, negative number provided"
+/*  FE_REGEX_COMPILE_FAILED */       ,"regular expression failed to compile"
 
 /*  FE_FOPEN_MUST_READ_OR_WRITE */   ,"must include read mode ('r') or write mode ('w') in flag string"
 /*  FE_FOPEN_OPEN_FAILED */          ,"internal call to open() failed"
@@ -31,16 +64,26 @@ const char* ferror_strings[FE_MAX_ERROR_ID] = {
 /*  FE_FCLOSE_UNFLOCK_FAILED */      ,"clearing POSIX file lock failed"
 /*  FE_FCLOSE_FCLOSE_FAILED_LOL */   ,"internal call to fclose() failed (lol how did you do that)"
 /*  FE_FREAD_GETLINE_FAILED */       ,"internal call to getline() failed"
+/*  FE_FREAD_FREAD_FAILED */         ,"internal call to fread() failed"
 /*  FE_FWRITE_FPUTS_FAILED */        ,"internal call to fputs() failed"
 /*  FE_DIR_DIROPEN_FAILED, */        ,"internal call to diropen() failed"
 /*  FE_DIR_READDIR_FAILED, */        ,"internal call to readdir() failed"
 /*  FE_FILE_REALPATH_FAILED */       ,"internal call to realpath() failed"
 /*  FE_FILE_STAT_FAILED */           ,"internal call to stat() failed"
+/*  FE_FILEMAP_MMAP_FAILED */        ,"internal call to mmap() failed"
+/*  FE_FILEMAP_RELEASED */           ,"file map has already been released"
 
 /*  FE_PROCESS_PIPE_CREATE_FAILED */ ,"internal call to pipe() failed"
 /*  FE_PROCESS_FORK_FAILED */        ,"internal call to fork() failed"
 /*  FE_PROCESS_CREATE_FAILED */      ,"process creation failed, internal impossible fallthrough!?"
 /*  FE_PROCESS_CLOSE_FAILED */       ,"process close failed"
+/*  FE_PROCESS_BAD_COMMAND */        ,"each command must be a non-empty array of strings"
+/*  FE_PROCESS_POLL_FAILED */        ,"internal call to poll() failed"
+
+/*  FE_IO_EPOLL_FAILED */            ,"internal call to epoll() failed"
+/*  FE_IO_READ_FAILED */             ,"internal call to read() failed"
+
+/*  FE_OUT_OF_MEMORY */              ,"out of memory"
 
 /*  FE_INVALID_ERROR_ID */           ,"(invalid ferror_id)"
 };
@@ -51,3 +94,61 @@ const char* cc_ferror_to_string(int ferror_id) {
     }
     return ferror_strings[ferror_id];
 }
+
+
+// There's one error object per ferror id, created up front.  Natives hand
+// them back instead of allocating a fresh one on every failure.  The VM reads
+// the error right after the native returns, so stamping the errno or detail
+// into the shared object is safe.
+static ObjFunctionError* ferror_singletons[FE_MAX_ERROR_ID];
+static char ferror_detail[256];
+
+void cc_init_ferrors() {
+    for(int i = 0; i < FE_MAX_ERROR_ID; i++) {
+        ferror_singletons[i] = newFunctionError(i, 0);
+    }
+}
+
+ObjFunctionError* cc_ferror(int ferror_id, int sys_errno) {
+    if(ferror_id >= FE_MAX_ERROR_ID) {
+        ferror_id = FE_INVALID_ERROR_ID;
+    }
+    ObjFunctionError* err = ferror_singletons[ferror_id];
+    err->sys_errno = sys_errno;
+    err->detail = NULL;
+    return err;
+}
+
+// The detail is copied, so it can come from a buffer on the native's stack.
+ObjFunctionError* cc_ferror_detail(int ferror_id, const char* detail) {
+    ObjFunctionError* err = cc_ferror(ferror_id, 0);
+    snprintf(ferror_detail, sizeof(ferror_detail), "%s", detail);
+    err->detail = ferror_detail;
+    return err;
+}
+
+int cc_ferror_for_arg_count(int min_args, int max_args) {
+    if(min_args == 1 && max_args == NATIVE_VARIADIC) { return FE_ARG_GTE_1; }
+    if(min_args == 0 && max_args == 0) { return FE_ARG_COUNT_0; }
+    if(min_args == 1 && max_args == 1) { return FE_ARG_COUNT_1; }
+    if(min_args == 2 && max_args == 2) { return FE_ARG_COUNT_2; }
+    if(min_args == 3 && max_args == 3) { return FE_ARG_COUNT_3; }
+    if(min_args == 0 && max_args == 1) { return FE_ARG_COUNT_0_1; }
+    if(min_args == 1 && max_args == 2) { return FE_ARG_COUNT_1_2; }
+    if(min_args == 2 && max_args == 3) { return FE_ARG_COUNT_2_3; }
+    if(min_args == 3 && max_args == 4) { return FE_ARG_COUNT_3_4; }
+    return FE_INVALID_ARGUMENTS;
+}
+
+// The FE_ARG_<position>_<type> ids come in one block per position, each with
+// the types in the same order, so the id is found by counting into the block.
+int cc_ferror_for_arg_type(int arg_index, char arg_type) {
+    static const char types[] = "snahfmc";
+    const char* type = arg_type == '\0' ? NULL : strchr(types, arg_type);
+    if(arg_index < 1 || type == NULL) {
+        return FE_INVALID_ARGUMENTS;
+    }
+    int per_position = FE_ARG_2_STRING - FE_ARG_1_STRING;
+    int position = arg_index < 5 ? arg_index - 1 : 4;
+    return FE_ARG_1_STRING + position * per_position + (int)(type - types);
+}
@@ -3,28 +3,59 @@
 
 #include <errno.h>
 
+#include "../object.h"
+
 typedef enum {
     FE_NONE,
 
     FE_INVALID_ARGUMENTS,
     FE_ARG_GTE_1,
+    FE_ARG_COUNT_0,
     FE_ARG_COUNT_1,
     FE_ARG_COUNT_2,
     FE_ARG_COUNT_3,
     FE_ARG_COUNT_1_2,
+    FE_ARG_COUNT_0_1,
     FE_ARG_COUNT_2_3,
+    FE_ARG_COUNT_3_4,
     FE_ARG_1_STRING,
-    FE_ARG_1_FH,
     FE_ARG_1_NUMBER,
     FE_ARG_1_ARRAY,
+    FE_ARG_1_HASH,
+    FE_ARG_1_FH,
+    FE_ARG_1_FILEMAP,
+    FE_ARG_1_FUNCTION,
     FE_ARG_2_STRING,
     FE_ARG_2_NUMBER,
     FE_ARG_2_ARRAY,
+    FE_ARG_2_HASH,
+    FE_ARG_2_FH,
+    FE_ARG_2_FILEMAP,
     FE_ARG_2_FUNCTION,
+    FE_ARG_3_STRING,
     FE_ARG_3_NUMBER,
     FE_ARG_3_ARRAY,
+    FE_ARG_3_HASH,
+    FE_ARG_3_FH,
+    FE_ARG_3_FILEMAP,
+    FE_ARG_3_FUNCTION,
+    FE_ARG_4_STRING,
+    FE_ARG_4_NUMBER,
+    FE_ARG_4_ARRAY,
+    FE_ARG_4_HASH,
+    FE_ARG_4_FH,
+    FE_ARG_4_FILEMAP,
+    FE_ARG_4_FUNCTION,
+    FE_ARG_N_STRING,
+    FE_ARG_N_NUMBER,
+    FE_ARG_N_ARRAY,
+    FE_ARG_N_HASH,
+    FE_ARG_N_FH,
+    FE_ARG_N_FILEMAP,
+    FE_ARG_N_FUNCTION,
 
     FE_STRING_SPLIT_NEGATIVE_LIMIT,
+    FE_REGEX_COMPILE_FAILED,
 
     FE_FOPEN_MUST_READ_OR_WRITE,
     FE_FOPEN_OPEN_FAILED,
@@ -34,25 +65,41 @@ typedef enum {
     FE_FCLOSE_UNFLOCK_FAILED,
     FE_FCLOSE_FCLOSE_FAILED_LOL,
     FE_FREAD_GETLINE_FAILED,
+    FE_FREAD_FREAD_FAILED,
     FE_FWRITE_FPUTS_FAILED,
     FE_DIR_DIROPEN_FAILED,
     FE_DIR_READDIR_FAILED,
     FE_FILE_REALPATH_FAILED,
     FE_FILE_STAT_FAILED,
+    FE_FILEMAP_MMAP_FAILED,
+    FE_FILEMAP_RELEASED,
 
     FE_PROCESS_PIPE_CREATE_FAILED,
     FE_PROCESS_FORK_FAILED,
     FE_PROCESS_CREATE_FAILED,
     FE_PROCESS_CLOSE_FAILED,
+    FE_PROCESS_BAD_COMMAND,
+    FE_PROCESS_POLL_FAILED,
+
+    FE_IO_EPOLL_FAILED,
+    FE_IO_READ_FAILED,
+
+    FE_OUT_OF_MEMORY,
 
     FE_INVALID_ERROR_ID,
     FE_MAX_ERROR_ID
 } FErrorIDs;
 
-#define FERROR_VAL(ferror_id) OBJ_VAL(newFunctionError(ferror_id, 0))
-#define FERROR_AUTOERRNO_VAL(ferror_id) OBJ_VAL(newFunctionError(ferror_id, errno))
-#define FERROR_ERRNO_VAL(ferror_id, errnum) OBJ_VAL(newFunctionError(ferror_id, errnum))
+#define FERROR_VAL(ferror_id) OBJ_VAL(cc_ferror(ferror_id, 0))
+#define FERROR_AUTOERRNO_VAL(ferror_id) OBJ_VAL(cc_ferror(ferror_id, errno))
+#define FERROR_ERRNO_VAL(ferror_id, errnum) OBJ_VAL(cc_ferror(ferror_id, errnum))
+#define FERROR_DETAIL_VAL(ferror_id, detail) OBJ_VAL(cc_ferror_detail(ferror_id, detail))
 
+void cc_init_ferrors();
+ObjFunctionError* cc_ferror(int ferror_id, int sys_errno);
+ObjFunctionError* cc_ferror_detail(int ferror_id, const char* detail);
 const char* cc_ferror_to_string(int ferror_id);
+int cc_ferror_for_arg_count(int min_args, int max_args);
+int cc_ferror_for_arg_type(int arg_index, char arg_type);
 
 #endif
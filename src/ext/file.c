@@ -9,6 +9,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <dirent.h>
@@ -20,20 +21,60 @@
 
 #include "userarray.h"
 #include "ferrors.h"
+#include "io.h"
+
+// stdio's buffer for every file handle.  Bigger than the default so line by
+// line reading makes fewer read() calls.
+#define FH_BUFFER_SIZE (64 * 1024)
+// Where fh_read_block() starts when it can't tell how much is left to read.
+#define FH_READ_BLOCK_MIN (64 * 1024)
+// fh_read_block() treats any max_length this big as no limit at all.
+#define FH_READ_BLOCK_MAX INT64_C(0x4000000000000000)
+// fh_read_lines() sizes its array for the whole batch up front, unless the
+// batch is bigger than this.
+#define FH_READ_LINES_PRESIZE_MAX 65536
+
+
+// Reads the next line into the handle's buffer, which is reused from line to
+// line and only grows when a line longer than any before it comes along.  The
+// handle's stdio buffer means this mostly scans memory that one big read()
+// already filled.  Returns the length of the line, 0 at the end of the file,
+// or -1 with errno set on error.
+static ssize_t fh_getline(ObjFileHandle* fh) {
+    ssize_t res = getline(&fh->line_buffer, &fh->line_buffer_size, fh->handle);
+    if(res < 0) {
+        // getline() reports the end of the file the same way it reports an
+        // error, so tell them apart.
+        return feof(fh->handle) != 0 ? 0 : -1;
+    }
+    return res;
+}
 
 
 /**
  * file_exists(filename)
- * - returns nil on error
- * - returns true if the given filename exists
+ * - returns true if the given filename exists, false if it does not
+ * - raises an error if stat() fails for any other reason, like a permission
+ *   problem along the path
  */
-Value cc_function_file_exists(int arg_count, Value* args) { return NIL_VAL; }
+Value cc_function_file_exists(int arg_count, Value* args) {
+    ObjString* filename = AS_STRING(args[0]);
+
+    struct stat status;
+    if(stat(filename->chars, &status) == 0) {
+        return BOOL_VAL(true);
+    }
+    if(errno == ENOENT || errno == ENOTDIR) {
+        return BOOL_VAL(false);
+    }
+    return FERROR_AUTOERRNO_VAL(FE_FILE_STAT_FAILED);
+}
 
 
 /**
  * file_open(filename, mode)
- * - returns nil on parameter error
- * - returns false on file open error
+ * - raises an error if the arguments are the wrong number or type
+ * - raises an error if the file can't be opened or locked
  * - returns filehandle on success
  * - mode may be:
  *   - "r" to read from the file, or fail if it does not exist
@@ -47,10 +88,6 @@ Value cc_function_file_exists(int arg_count, Value* args) { return NIL_VAL; }
  *     lines delimited by things other than newlines (like CRLF) really annoying
  */
 Value cc_function_file_open(int arg_count, Value* args) {
-    if(arg_count < 1 || arg_count > 2) { return FERROR_VAL(FE_ARG_COUNT_1_2); }
-    if(!IS_STRING(args[0])) { return FERROR_VAL(FE_ARG_1_STRING); }
-    if(arg_count == 2 && !IS_STRING(args[1])) { return FERROR_VAL(FE_ARG_2_STRING); }
-
     // We only support passing read, write, or both.  All other flags are ignored.
     bool is_reader = true;
     bool is_writer = false;
@@ -82,6 +119,7 @@ Value cc_function_file_open(int arg_count, Value* args) {
     if(handle == NULL) {
         return FERROR_AUTOERRNO_VAL(FE_FOPEN_FDOPEN_FAILED);
     }
+    setvbuf(handle, NULL, _IOFBF, FH_BUFFER_SIZE);
     ObjFileHandle* fh = newFileHandle(handle);
     fh->lock.l_type = is_writer ? F_WRLCK : F_RDLCK;
     fh->is_writer = is_writer;
@@ -99,15 +137,13 @@ Value cc_function_file_open(int arg_count, Value* args) {
 
 /**
  * file_close(fh)
- * - returns nil on parameter error
- * - returns true on success... yes, this can fail.  Don't ask how.
+ * - raises an error if the arguments are the wrong number or type
+ * - returns true on success... yes, this can fail.  Don't ask how.  When it
+ *   does, it raises an error.
  */
 Value cc_function_fh_close(int arg_count, Value* args) {
-    if(arg_count != 1 || !IS_FILEHANDLE(args[0])) {
-        return FERROR_VAL(FE_ARG_1_FH);
-    }
-
     ObjFileHandle* fh = AS_FILEHANDLE(args[0]);
+    cc_io_unwatch(fh);
     // The close automatically flushes, but let's do that *before* the unlock.
     if(fh->is_writer && fflush(fh->handle) != 0) {
         return FERROR_AUTOERRNO_VAL(FE_FCLOSE_FLUSH_FAILED);
@@ -127,58 +163,137 @@ Value cc_function_fh_close(int arg_count, Value* args) {
         return FERROR_AUTOERRNO_VAL(FE_FCLOSE_FCLOSE_FAILED_LOL);
     }
     fh->is_open = false;
+    free(fh->line_buffer);
+    fh->line_buffer = NULL;
+    fh->line_buffer_size = 0;
     return BOOL_VAL(true);
 }
 
 
 /**
  * file_read_line(fh)
- * - returns nil on parameter error
+ * - raises an error if the arguments are the wrong number or type, or if the
+ *   read fails
  * - returns false on end of file
  * - returns the string next line otherwise, including the newline
  */
 Value cc_function_fh_read_line(int arg_count, Value* args) {
-    if(arg_count != 1 || !IS_FILEHANDLE(args[0])) {
-        return FERROR_VAL(FE_ARG_1_FH);
-    }
     ObjFileHandle* fh = AS_FILEHANDLE(args[0]);
 
     // Don't even bother if we've reached EOF, if the file isn't open, or it's
     // not open for reading.
-    if(feof(fh->handle) != 0 || !fh->is_reader || !fh->is_open) {
+    if(!fh->is_open || !fh->is_reader || feof(fh->handle) != 0) {
         return BOOL_VAL(false);
     }
 
-    char* buffer = NULL;
-    size_t bufflen = 0;
-    ssize_t res = getline(&buffer, &bufflen, fh->handle);
+    ssize_t res = fh_getline(fh);
     if(res < 0) {
-        // So we should have been given the number of bytes put into the buffer,
-        // but instead we got an error.  This can happen if we are at EOF and
-        // we tried unsuccessfully to read, or if there was some sort of error.
-        // The EOF check at the top should have protected us from fuckery...
-        int old_errno = errno;
-        free(buffer);
-        if(feof(fh->handle) != 0) {
+        return FERROR_AUTOERRNO_VAL(FE_FREAD_GETLINE_FAILED);
+    }
+    if(res == 0) {
+        return BOOL_VAL(false);
+    }
+    return OBJ_VAL(copyUninternedString(fh->line_buffer, res));
+}
+
+
+/**
+ * fh_read_lines(fh, count?)
+ * - returns false if the file is at EOF, closed, or not open for reading, or
+ *   if count is negative or not a whole number
+ * - returns an array of up to count lines, each including its newline, or of
+ *   every remaining line if count is missing or zero
+ */
+Value cc_function_fh_read_lines(int arg_count, Value* args) {
+    ObjFileHandle* fh = AS_FILEHANDLE(args[0]);
+    if(!fh->is_open || !fh->is_reader || feof(fh->handle) != 0) {
+        return BOOL_VAL(false);
+    }
+
+    int64_t count = INT64_MAX;
+    if(arg_count == 2) {
+        double raw_count = AS_NUMBER(args[1]);
+        if(!(raw_count >= 0) || raw_count != trunc(raw_count)) {
             return BOOL_VAL(false);
         }
-        return FERROR_ERRNO_VAL(FE_FREAD_GETLINE_FAILED, old_errno);
+        if(raw_count >= 1 && raw_count < (double)INT64_MAX) {
+            count = (int64_t)raw_count;
+        }
     }
-    ObjString* str = copyString(buffer, res);
-    free(buffer);
-    return OBJ_VAL(str);
+
+    // A batch of a known size gets its array up front.  Bigger ones grow as
+    // lines arrive, so a huge count can't allocate for lines that never show.
+    ObjUserArray* lines = newUserArray();
+    if(count <= FH_READ_LINES_PRESIZE_MAX) {
+        ua_grow(lines, count);
+    }
+
+    while(lines->inner.count < count) {
+        ssize_t res = fh_getline(fh);
+        if(res < 0) {
+            return FERROR_AUTOERRNO_VAL(FE_FREAD_GETLINE_FAILED);
+        }
+        if(res == 0) {
+            break;
+        }
+        ua_grow(lines, lines->inner.count);
+        lines->inner.values[ lines->inner.count++ ] = OBJ_VAL(copyUninternedString(fh->line_buffer, res));
+    }
+    if(lines->inner.count == 0) {
+        return BOOL_VAL(false);
+    }
+    return OBJ_VAL(lines);
+}
+
+
+/**
+ * fh_each_line(fh, callback)
+ * - returns the number of lines passed to the callback
+ * - reads the rest of the file a line at a time, stopping early if the
+ *   callback returns false
+ *
+ * => callback(line, index)
+ * - line includes its newline, and index counts from zero for each call
+ */
+Value cc_function_fh_each_line(int arg_count, Value* args) {
+    ObjFileHandle* fh = AS_FILEHANDLE(args[0]);
+    if(!fh->is_open || !fh->is_reader || feof(fh->handle) != 0) {
+        return NUMBER_VAL(0);
+    }
+
+    int64_t frame_count = vm.frameCount;
+    int64_t index = 0;
+    for(;;) {
+        ssize_t res = fh_getline(fh);
+        if(res < 0) {
+            return FERROR_AUTOERRNO_VAL(FE_FREAD_GETLINE_FAILED);
+        }
+        if(res == 0) {
+            break;
+        }
+        Value callback_args[2] = {
+            OBJ_VAL(copyUninternedString(fh->line_buffer, res)),
+            NUMBER_VAL(index++)
+        };
+        Value keep_going = callCallback(args[1], 2, callback_args);
+        if(vm.frameCount < frame_count) {
+            // The callback hit a runtime error, which has already been reported.
+            return NIL_VAL;
+        }
+        if(IS_BOOL(keep_going) && !AS_BOOL(keep_going)) {
+            break;
+        }
+    }
+    return NUMBER_VAL(index);
 }
 
 
 /**
  * file_at_eof(fh)
- * - returns nil on parameter error
+ * - raises an error if the arguments are the wrong number or type
  * - returns true if the end of the file has been reached
  */
 Value cc_function_fh_at_eof(int arg_count, Value* args) {
-    if(arg_count != 1 || !IS_FILEHANDLE(args[0])) {
-        return FERROR_VAL(FE_ARG_1_FH);
-    }
     if(!AS_FILEHANDLE(args[0])->is_open) {
         return BOOL_VAL(false);
     }
@@ -189,14 +304,11 @@ Value cc_function_fh_at_eof(int arg_count, Value* args) {
 
 /**
  * file_write(fh, data)
- * - returns nil on error
+ * - raises an error if the write fails
+ * - returns false if the file is closed or not open for writing
  * - returns the number of bytes written
  */
 Value cc_function_fh_write(int arg_count, Value* args) {
-    if(arg_count != 2) { return FERROR_VAL(FE_ARG_COUNT_2); }
-    if(!IS_FILEHANDLE(args[0])) { return FERROR_VAL(FE_ARG_1_FH); }
-    if(!IS_STRING(args[1])) { return FERROR_VAL(FE_ARG_2_STRING); }
-
     ObjFileHandle* fh = AS_FILEHANDLE(args[0]);
     if(!fh->is_writer|| !fh->is_open) {
         return BOOL_VAL(false);
@@ -212,12 +324,78 @@ Value cc_function_fh_write(int arg_count, Value* args) {
 
 /**
  * file_read_block(fh, max_length?)
- * - returns nil on error
+ * - raises an error if the read fails
  * - returns false on end of file
  * - returns a string containing up to max_length bytes
  *   - if max_length is missing or zero, the entire file will be read
  */
-Value cc_function_fh_read_block(int arg_count, Value* args) { return NIL_VAL; }
+Value cc_function_fh_read_block(int arg_count, Value* args) {
+    ObjFileHandle* fh = AS_FILEHANDLE(args[0]);
+    if(!fh->is_open || !fh->is_reader || feof(fh->handle) != 0) {
+        return BOOL_VAL(false);
+    }
+
+    // Anything at least as big as a file can get is the same as asking for
+    // the whole file, and keeps huge counts from overflowing the conversion.
+    int64_t max_length = 0;
+    if(arg_count == 2 && AS_NUMBER(args[1]) >= 1 && AS_NUMBER(args[1]) < (double)FH_READ_BLOCK_MAX) {
+        max_length = (int64_t)AS_NUMBER(args[1]);
+    }
+
+    // The bytes are read straight into the storage the string will own.  For
+    // a regular file, its size says how much is left, so storage is never
+    // bigger than that and the rest of the file arrives with a single fread().
+    // Reads this big skip stdio's buffer and go directly into ours.  Anything
+    // else starts small and grows as the bytes turn up, up to max_length.
+    int64_t capacity = FH_READ_BLOCK_MIN;
+    struct stat info;
+    off_t position = ftello(fh->handle);
+    if(position >= 0 && fstat(fileno(fh->handle), &info) == 0 &&
+       S_ISREG(info.st_mode) && info.st_size > position) {
+        capacity = info.st_size - position;
+    }
+    if(max_length > 0 && max_length < capacity) {
+        capacity = max_length;
+    }
+
+    char* chars = ALLOCATE(char, capacity + 1);
+    int64_t length = 0;
+    for(;;) {
+        length += fread(chars + length, 1, capacity - length, fh->handle);
+        if(length < capacity || length == max_length) {
+            break;
+        }
+        // We filled the buffer but were allowed more.  Make sure there's
+        // actually more before growing, so a file that was exactly the size
+        // we expected doesn't get its storage doubled for nothing.
+        int next = getc(fh->handle);
+        if(next == EOF) {
+            break;
+        }
+        int64_t new_capacity = capacity * 2;
+        if(max_length > 0 && max_length < new_capacity) {
+            new_capacity = max_length;
+        }
+        chars = GROW_ARRAY(chars, char, capacity + 1, new_capacity + 1);
+        capacity = new_capacity;
+        chars[length++] = (char)next;
+    }
+
+    if(ferror(fh->handle) != 0) {
+        int old_errno = errno;
+        FREE_ARRAY(char, chars, capacity + 1);
+        return FERROR_ERRNO_VAL(FE_FREAD_FREAD_FAILED, old_errno);
+    }
+    if(length == 0) {
+        FREE_ARRAY(char, chars, capacity + 1);
+        return BOOL_VAL(false);
+    }
+    if(length < capacity) {
+        chars = GROW_ARRAY(chars, char, capacity + 1, length + 1);
+    }
+    chars[length] = '\0';
+    return OBJ_VAL(takeUninternedString(chars, length));
+}
 
 
 /**
@@ -263,9 +441,6 @@ Value cc_function_fh_seek_end(int arg_count, Value* args) { return NIL_VAL; }
 
 
 Value cc_function_dir_get_all(int arg_count, Value* args) {
-    if(arg_count != 1) { return FERROR_VAL(FE_ARG_COUNT_1); }
-    if(!IS_STRING(args[0])) { return FERROR_VAL(FE_ARG_1_STRING); }
-
     DIR* dh = opendir(AS_CSTRING(args[0]));
     if(dh == NULL) {
         return FERROR_AUTOERRNO_VAL(FE_DIR_DIROPEN_FAILED);
@@ -302,26 +477,20 @@ Value cc_function_dir_get_all(int arg_count, Value* args) {
 
 
 Value cc_function_file_resolve_path(int arg_count, Value* args) {
-    if(arg_count != 1) { return FERROR_VAL(FE_ARG_COUNT_1); }
-    if(!IS_STRING(args[0])) { return FERROR_VAL(FE_ARG_1_STRING); }
-
     ObjString* filename = AS_STRING(args[0]);
 
     char* resolved = ALLOCATE(char, PATH_MAX);
-    realpath(filename->chars, resolved);
-    if(resolved == NULL) {
+    if(realpath(filename->chars, resolved) == NULL) {
+        FREE_ARRAY(char, resolved, PATH_MAX);
         return FERROR_AUTOERRNO_VAL(FE_FILE_REALPATH_FAILED);
     }
     ObjString* fp = copyString(resolved, strlen(resolved));
-    FREE(char, resolved);
+    FREE_ARRAY(char, resolved, PATH_MAX);
     return OBJ_VAL(fp);
 }
 
 
 Value cc_function_file_is_directory(int arg_count, Value* args) {
-    if(arg_count != 1) { return FERROR_VAL(FE_ARG_COUNT_1); }
-    if(!IS_STRING(args[0])) { return FERROR_VAL(FE_ARG_1_STRING); }
-
     ObjString* filename = AS_STRING(args[0]);
 
     struct stat status;
@@ -333,9 +502,6 @@ Value cc_function_file_is_directory(int arg_count, Value* args) {
 
 
 Value cc_function_file_is_regular(int arg_count, Value* args) {
-    if(arg_count != 1) { return FERROR_VAL(FE_ARG_COUNT_1); }
-    if(!IS_STRING(args[0])) { return FERROR_VAL(FE_ARG_1_STRING); }
-
     ObjString* filename = AS_STRING(args[0]);
 
     struct stat status;
@@ -347,9 +513,6 @@ Value cc_function_file_is_regular(int arg_count, Value* args) {
 
 
 Value cc_function_file_is_symlink(int arg_count, Value* args) {
-    if(arg_count != 1) { return FERROR_VAL(FE_ARG_COUNT_1); }
-    if(!IS_STRING(args[0])) { return FERROR_VAL(FE_ARG_1_STRING); }
-
     ObjString* filename = AS_STRING(args[0]);
 
     struct stat status;
@@ -361,9 +524,6 @@ Value cc_function_file_is_symlink(int arg_count, Value* args) {
 
 
 Value cc_function_file_is_special(int arg_count, Value* args) {
-    if(arg_count != 1) { return FERROR_VAL(FE_ARG_COUNT_1); }
-    if(!IS_STRING(args[0])) { return FERROR_VAL(FE_ARG_1_STRING); }
-
     ObjString* filename = AS_STRING(args[0]);
 
     struct stat status;
@@ -384,24 +544,26 @@ Value cc_function_file_is_special(int arg_count, Value* args) {
 
 
 void cc_register_ext_file() {
-    defineNative("file_exists",         cc_function_file_exists);
-    defineNative("file_open",           cc_function_file_open);
-
-    defineNative("fh_close",            cc_function_fh_close);
-    defineNative("fh_read_line",        cc_function_fh_read_line);
-    defineNative("fh_at_eof",           cc_function_fh_at_eof);
-    defineNative("fh_write",            cc_function_fh_write);
-    defineNative("fh_read_block",       cc_function_fh_read_block);
-    defineNative("fh_truncate",         cc_function_fh_truncate);
-    defineNative("fh_position",         cc_function_fh_position);
-    defineNative("fh_seek",             cc_function_fh_seek);
-    defineNative("fh_seek_start",       cc_function_fh_seek_start);
-    defineNative("fh_seek_end",         cc_function_fh_seek_end);
-
-    defineNative("dir_get_all",         cc_function_dir_get_all);
-    defineNative("file_resolve_path",   cc_function_file_resolve_path);
-    defineNative("file_is_directory",   cc_function_file_is_directory);
-    defineNative("file_is_regular",     cc_function_file_is_regular);
-    defineNative("file_is_symlink",     cc_function_file_is_symlink);
-    defineNative("file_is_special",     cc_function_file_is_special);
+    defineNativeSignature("file_exists", cc_function_file_exists, 1, 1, "s");
+    defineNativeSignature("file_open", cc_function_file_open, 1, 2, "ss");
+
+    defineNativeSignature("fh_close",     cc_function_fh_close,     1, 1, "f");
+    defineNativeSignature("fh_read_line", cc_function_fh_read_line, 1, 1, "f");
+    defineNativeSignature("fh_read_lines", cc_function_fh_read_lines, 1, 2, "fn");
+    defineNativeSignature("fh_each_line", cc_function_fh_each_line, 2, 2, "fc");
+    defineNativeSignature("fh_at_eof",    cc_function_fh_at_eof,    1, 1, "f");
+    defineNativeSignature("fh_write",     cc_function_fh_write,     2, 2, "fs");
+    defineNativeSignature("fh_read_block", cc_function_fh_read_block, 1, 2, "fn");
+    defineNative("fh_truncate",           cc_function_fh_truncate);
+    defineNative("fh_position",           cc_function_fh_position);
+    defineNative("fh_seek",               cc_function_fh_seek);
+    defineNative("fh_seek_start",         cc_function_fh_seek_start);
+    defineNative("fh_seek_end",           cc_function_fh_seek_end);
+
+    defineNativeSignature("dir_get_all",       cc_function_dir_get_all,       1, 1, "s");
+    defineNativeSignature("file_resolve_path", cc_function_file_resolve_path, 1, 1, "s");
+    defineNativeSignature("file_is_directory", cc_function_file_is_directory, 1, 1, "s");
+    defineNativeSignature("file_is_regular",   cc_function_file_is_regular,   1, 1, "s");
+    defineNativeSignature("file_is_symlink",   cc_function_file_is_symlink,   1, 1, "s");
+    defineNativeSignature("file_is_special",   cc_function_file_is_special,   1, 1, "s");
 }
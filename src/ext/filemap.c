@@ -0,0 +1,276 @@
+/*
+    File maps read a whole file through mmap() and hand out views into it.  A
+    view is a byte range of the mapped pages, so searching and splitting one
+    reads the file where the kernel put it instead of copying it into strings
+    first.  Only fm_string() copies, and only the bytes it's asked for.
+
+    Views stay valid until they are released, and the file stays mapped until
+    every view into it has been.  Views are only released explicitly (or when
+    the VM shuts down), so code working through big files should release what
+    it's done with.
+*/
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../common.h"
+#include "../memory.h"
+#include "../vm.h"
+
+#include "filemap.h"
+#include "string.h"
+#include "userarray.h"
+#include "ferrors.h"
+
+
+// Byte offsets arrive as doubles, and have to be whole numbers inside the view.
+static bool fm_offset(ObjFileMap* view, double raw_offset, int64_t* offset) {
+    if(!(raw_offset >= 0 && raw_offset <= (double)view->length) || raw_offset != trunc(raw_offset)) {
+        return false;
+    }
+    *offset = (int64_t)raw_offset;
+    return true;
+}
+
+
+static void fm_append(ObjUserArray* views, ObjFileMap* view, const char* start, int64_t length) {
+    ua_grow(views, views->inner.count + 1);
+    views->inner.values[ views->inner.count++ ] = OBJ_VAL(newFileMap(view->mapping, start, length));
+}
+
+
+/**
+ * file_map(filename)
+ * - returns a file map viewing the entire file
+ * - the file is mapped read only, and later changes to it may or may not show
+ *   up in the map
+ */
+Value cc_function_file_map(int arg_count, Value* args) {
+    int fd = open(AS_CSTRING(args[0]), O_RDONLY);
+    if(fd < 0) {
+        return FERROR_AUTOERRNO_VAL(FE_FOPEN_OPEN_FAILED);
+    }
+    struct stat info;
+    if(fstat(fd, &info) != 0) {
+        int old_errno = errno;
+        close(fd);
+        return FERROR_ERRNO_VAL(FE_FILE_STAT_FAILED, old_errno);
+    }
+
+    // mmap() refuses empty mappings, but an empty file is still a fine thing
+    // to view.
+    char* base = NULL;
+    if(info.st_size > 0) {
+        base = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(base == MAP_FAILED) {
+            int old_errno = errno;
+            close(fd);
+            return FERROR_ERRNO_VAL(FE_FILEMAP_MMAP_FAILED, old_errno);
+        }
+        // Most maps get read front to back, so ask for aggressive readahead.
+        madvise(base, info.st_size, MADV_SEQUENTIAL);
+    }
+    // The mapping holds its own reference to the file.
+    close(fd);
+
+    FileMapping* mapping = ALLOCATE(FileMapping, 1);
+    mapping->base = base;
+    mapping->size = info.st_size;
+    mapping->views = 0;
+    return OBJ_VAL(newFileMap(mapping, base, info.st_size));
+}
+
+
+/**
+ * fm_length(view)
+ * - returns the number of bytes in the view
+ */
+Value cc_function_fm_length(int arg_count, Value* args) {
+    ObjFileMap* view = AS_FILEMAP(args[0]);
+    if(view->mapping == NULL) {
+        return FERROR_VAL(FE_FILEMAP_RELEASED);
+    }
+    return NUMBER_VAL(view->length);
+}
+
+
+/**
+ * fm_slice(view, start, end?)
+ * - returns false if start or end fall outside of the view, or end is before
+ *   start
+ * - returns a new view of the bytes from start up to but not including end,
+ *   or to the end of the view if end is omitted.  Nothing is copied.
+ */
+Value cc_function_fm_slice(int arg_count, Value* args) {
+    ObjFileMap* view = AS_FILEMAP(args[0]);
+    if(view->mapping == NULL) {
+        return FERROR_VAL(FE_FILEMAP_RELEASED);
+    }
+    int64_t start = 0;
+    int64_t end = view->length;
+    if(!fm_offset(view, AS_NUMBER(args[1]), &start) ||
+       (arg_count == 3 && !fm_offset(view, AS_NUMBER(args[2]), &end)) ||
+       end < start) {
+        return BOOL_VAL(false);
+    }
+    return OBJ_VAL(newFileMap(view->mapping, view->start + start, end - start));
+}
+
+
+/**
+ * fm_index_of(view, needle_string, starting_index?)
+ * - returns false if the needle is empty or can't be found
+ * - returns the byte offset into the view where the needle first appears, at
+ *   or after the starting index
+ */
+Value cc_function_fm_index_of(int arg_count, Value* args) {
+    ObjFileMap* view = AS_FILEMAP(args[0]);
+    ObjString* needle = AS_STRING(args[1]);
+    if(view->mapping == NULL) {
+        return FERROR_VAL(FE_FILEMAP_RELEASED);
+    }
+    int64_t starting_index = 0;
+    if(arg_count == 3 && !fm_offset(view, AS_NUMBER(args[2]), &starting_index)) {
+        return BOOL_VAL(false);
+    }
+    if(needle->length < 1 || starting_index > view->length - needle->length) {
+        return BOOL_VAL(false);
+    }
+    int64_t found = st_find(
+        view->start + starting_index, view->length - starting_index,
+        needle->chars, needle->length
+    );
+    if(found < 0) {
+        return BOOL_VAL(false);
+    }
+    return NUMBER_VAL(starting_index + found);
+}
+
+
+/**
+ * fm_split(view, delimiter_string)
+ * - returns an array of views of the pieces of the view between delimiters,
+ *   the same way string_split() would break up the same string: a delimiter
+ *   at the very end doesn't start another, empty piece, and an empty view
+ *   has no pieces at all.  Nothing is copied.
+ */
+Value cc_function_fm_split(int arg_count, Value* args) {
+    ObjFileMap* view = AS_FILEMAP(args[0]);
+    ObjString* delimiter = AS_STRING(args[1]);
+    if(view->mapping == NULL) {
+        return FERROR_VAL(FE_FILEMAP_RELEASED);
+    }
+    if(delimiter->length < 1) {
+        return FERROR_VAL(FE_INVALID_ARGUMENTS);
+    }
+
+    ObjUserArray* pieces = newUserArray();
+    const char* cursor = view->start;
+    const char* end = view->start + view->length;
+    while(cursor < end) {
+        int64_t found = st_find(cursor, end - cursor, delimiter->chars, delimiter->length);
+        if(found < 0) {
+            fm_append(pieces, view, cursor, end - cursor);
+            break;
+        }
+        fm_append(pieces, view, cursor, found);
+        cursor += found + delimiter->length;
+    }
+    return OBJ_VAL(pieces);
+}
+
+
+/**
+ * fm_lines(view)
+ * - returns an array of views of each line in the view, without their
+ *   newlines.  A newline at the very end doesn't start another, empty line.
+ */
+Value cc_function_fm_lines(int arg_count, Value* args) {
+    ObjFileMap* view = AS_FILEMAP(args[0]);
+    if(view->mapping == NULL) {
+        return FERROR_VAL(FE_FILEMAP_RELEASED);
+    }
+
+    ObjUserArray* lines = newUserArray();
+    const char* cursor = view->start;
+    const char* end = view->start + view->length;
+    while(cursor < end) {
+        const char* newline = memchr(cursor, '\n', end - cursor);
+        if(newline == NULL) {
+            fm_append(lines, view, cursor, end - cursor);
+            break;
+        }
+        fm_append(lines, view, cursor, newline - cursor);
+        cursor = newline + 1;
+    }
+    return OBJ_VAL(lines);
+}
+
+
+/**
+ * fm_equals(view, string)
+ * - returns true if the view holds exactly the bytes in the string
+ */
+Value cc_function_fm_equals(int arg_count, Value* args) {
+    ObjFileMap* view = AS_FILEMAP(args[0]);
+    ObjString* str = AS_STRING(args[1]);
+    if(view->mapping == NULL) {
+        return FERROR_VAL(FE_FILEMAP_RELEASED);
+    }
+    return BOOL_VAL(
+        view->length == str->length &&
+        (str->length == 0 || memcmp(view->start, str->chars, str->length) == 0)
+    );
+}
+
+
+/**
+ * fm_string(view)
+ * - returns a string holding a copy of the bytes in the view
+ */
+Value cc_function_fm_string(int arg_count, Value* args) {
+    ObjFileMap* view = AS_FILEMAP(args[0]);
+    if(view->mapping == NULL) {
+        return FERROR_VAL(FE_FILEMAP_RELEASED);
+    }
+    return OBJ_VAL(copyUninternedString(view->start, view->length));
+}
+
+
+/**
+ * fm_release(view_or_array_of_views)
+ * - returns true if anything was released, false if it all already had been
+ * - the file is unmapped once the last view into it is released
+ */
+Value cc_function_fm_release(int arg_count, Value* args) {
+    if(IS_FILEMAP(args[0])) {
+        return BOOL_VAL(releaseFileMap(AS_FILEMAP(args[0])));
+    }
+    if(!IS_USERARRAY(args[0])) {
+        return FERROR_VAL(FE_ARG_1_FILEMAP);
+    }
+    ObjUserArray* views = AS_USERARRAY(args[0]);
+    bool released = false;
+    for(int64_t i = 0; i < views->inner.count; i++) {
+        if(IS_FILEMAP(views->inner.values[i])) {
+            released = releaseFileMap(AS_FILEMAP(views->inner.values[i])) || released;
+        }
+    }
+    return BOOL_VAL(released);
+}
+
+
+void cc_register_ext_filemap() {
+    defineNativeSignature("file_map",    cc_function_file_map,    1, 1, "s");
+    defineNativeSignature("fm_length",   cc_function_fm_length,   1, 1, "m");
+    defineNativeSignature("fm_slice",    cc_function_fm_slice,    2, 3, "mnn");
+    defineNativeSignature("fm_index_of", cc_function_fm_index_of, 2, 3, "msn");
+    defineNativeSignature("fm_split",    cc_function_fm_split,    2, 2, "ms");
+    defineNativeSignature("fm_lines",    cc_function_fm_lines,    1, 1, "m");
+    defineNativeSignature("fm_equals",   cc_function_fm_equals,   2, 2, "ms");
+    defineNativeSignature("fm_string",   cc_function_fm_string,   1, 1, "m");
+    defineNativeSignature("fm_release",  cc_function_fm_release,  1, 1, "*");
+}
@@ -0,0 +1,6 @@
+#ifndef cc_ext_filemap_h
+#define cc_ext_filemap_h
+
+void cc_register_ext_filemap();
+
+#endif
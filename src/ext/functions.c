@@ -4,11 +4,14 @@
 #include <math.h>
 
 #include "../common.h"
+#include "../memory.h"
 #include "../vm.h"
 
 #include "./number.h"
 #include "./string.h"
 #include "./file.h"
+#include "./filemap.h"
+#include "./io.h"
 #include "./process.h"
 #include "./userarray.h"
 #include "./ferrors.h"
@@ -27,8 +30,6 @@ Value cc_function_debug_dump_stack(int arg_count, Value* args) {
 
 
 Value cc_function_debug_dump_value_hash(int arg_count, Value* args) {
-    if(arg_count != 1) { return FERROR_VAL(FE_ARG_COUNT_1); }
-
     Value v = args[0];
     uint64_t hash = v.as.bits;
 
@@ -70,10 +71,14 @@ Value cc_function_time(int arg_count, Value* args) {
 }
 
 
+/**
+ * environment_getvar(name)
+ * - returns false if the variable isn't set
+ * - returns the value of the variable as a string
+ * - raises an error if name is missing or isn't a string.  It used to return
+ *   nil instead.
+ */
 Value cc_function_environment_getvar(int arg_count, Value* args) {
-    if(arg_count != 1) {
-        return NIL_VAL;
-    }
     char * env_var = getenv(AS_CSTRING(args[0]));
 
     if(env_var == NULL) {
@@ -85,10 +90,6 @@ Value cc_function_environment_getvar(int arg_count, Value* args) {
 
 
 Value cc_function_val_is_empty(int arg_count, Value* args) {
-    if(arg_count != 1) {
-        return FERROR_VAL(FE_ARG_COUNT_1);
-    }
-
     if(IS_NIL(args[0])) {
         // Nil never has a value, so it is always empty.
         return BOOL_VAL(true);
@@ -113,57 +114,41 @@ Value cc_function_val_is_empty(int arg_count, Value* args) {
 
 
 Value cc_function_val_is_string(int arg_count, Value* args) {
-    if(arg_count != 1) {
-        return FERROR_VAL(FE_ARG_COUNT_1);
-    }
     return BOOL_VAL(IS_STRING(args[0]));
 }
 
 
 Value cc_function_val_is_number(int arg_count, Value* args) {
-    if(arg_count != 1) {
-        return FERROR_VAL(FE_ARG_COUNT_1);
-    }
     return BOOL_VAL(IS_NUMBER(args[0]));
 }
 
 
 Value cc_function_val_is_boolean(int arg_count, Value* args) {
-    if(arg_count != 1) {
-        return FERROR_VAL(FE_ARG_COUNT_1);
-    }
     return BOOL_VAL(IS_BOOL(args[0]));
 }
 
 
 Value cc_function_val_is_array(int arg_count, Value* args) {
-    if(arg_count != 1) {
-        return FERROR_VAL(FE_ARG_COUNT_1);
-    }
     return BOOL_VAL(IS_USERARRAY(args[0]));
 }
 
 
 Value cc_function_val_is_hash(int arg_count, Value* args) {
-    if(arg_count != 1) {
-        return FERROR_VAL(FE_ARG_COUNT_1);
-    }
     return BOOL_VAL(IS_USERHASH(args[0]));
 }
 
 
 Value cc_function_val_is_filehandle(int arg_count, Value* args) {
-    if(arg_count != 1) {
-        return FERROR_VAL(FE_ARG_COUNT_1);
-    }
     return BOOL_VAL(IS_FILEHANDLE(args[0]));
 }
 
 
+Value cc_function_val_is_filemap(int arg_count, Value* args) {
+    return BOOL_VAL(IS_FILEMAP(args[0]));
+}
+
+
 Value cc_function_val_is_nan(int arg_count, Value* args) {
-    if(arg_count != 1) {
-        return FERROR_VAL(FE_ARG_COUNT_1);
-    }
     if(!IS_NUMBER(args[0])) {
         return BOOL_VAL(false);
     }
@@ -172,9 +157,6 @@ Value cc_function_val_is_nan(int arg_count, Value* args) {
 
 
 Value cc_function_val_is_infinity(int arg_count, Value* args) {
-    if(arg_count != 1) {
-        return FERROR_VAL(FE_ARG_COUNT_1);
-    }
     if(!IS_NUMBER(args[0])) {
         return BOOL_VAL(false);
     }
@@ -182,6 +164,56 @@ Value cc_function_val_is_infinity(int arg_count, Value* args) {
 }
 
 
+static void memory_stats_set(ObjUserHash* hash, const char* key, Value value) {
+  tableSet(&hash->table, copyString(key, strlen(key)), value);
+}
+
+
+static ObjUserHash* memory_usage_hash(MemoryUsage* usage) {
+  ObjUserHash* hash = newUserHash();
+  memory_stats_set(hash, "live", NUMBER_VAL(usage->live));
+  memory_stats_set(hash, "peak", NUMBER_VAL(usage->peak));
+  return hash;
+}
+
+
+/**
+ * debug_memory_stats()
+ * - returns a hash of "live", "peak", "allocations" and "allocated" (bytes
+ *   ever allocated) for everything, plus a hash of "live" and "peak" per
+ *   allocation category ("chunks", "strings", ...), and a hash of "count",
+ *   "live" and "peak" per object type under "object_types".  All sizes are in
+ *   bytes.
+ */
+Value cc_function_debug_memory_stats(int arg_count, Value* args) {
+  // Snapshot first, so building the result doesn't show up in it.
+  MemoryStats stats = memoryStats;
+
+  ObjUserHash* result = newUserHash();
+  memory_stats_set(result, "live", NUMBER_VAL(stats.total.live));
+  memory_stats_set(result, "peak", NUMBER_VAL(stats.total.peak));
+  memory_stats_set(result, "allocations", NUMBER_VAL(stats.allocations));
+  memory_stats_set(result, "allocated", NUMBER_VAL(stats.bytesAllocated));
+
+  for (int i = 0; i < MEM_CATEGORY_COUNT; i++) {
+    memory_stats_set(result, memoryCategoryName(i),
+                     OBJ_VAL(memory_usage_hash(&stats.categories[i])));
+  }
+
+  ObjUserHash* objects = newUserHash();
+  for (int i = 0; i < OBJ_TYPE_COUNT; i++) {
+    ObjUserHash* usage = memory_usage_hash(&stats.objects[i]);
+    memory_stats_set(usage, "count", NUMBER_VAL(stats.objectCounts[i]));
+    memory_stats_set(objects, objTypeName(i), OBJ_VAL(usage));
+  }
+  // The "objects" category is already in there, so the breakdown by type
+  // goes in a key of its own.
+  memory_stats_set(result, "object_types", OBJ_VAL(objects));
+
+  return OBJ_VAL(result);
+}
+
+
 extern int global_argc;
 extern const char** global_argv;
 Value cc_function_environment_arguments(int arg_count, Value* args) {
@@ -199,26 +231,30 @@ Value cc_function_environment_arguments(int arg_count, Value* args) {
 
 
 void cc_register_ext_functions() {
-  defineNative("debug_dump_stack",      cc_function_debug_dump_stack);
-  defineNative("debug_dump_value_hash", cc_function_debug_dump_value_hash);
-  defineNative("time",                  cc_function_time);
-  defineNative("environment_getvar",    cc_function_environment_getvar);
-  defineNative("environment_arguments", cc_function_environment_arguments);
-
-
-
-  defineNative("val_is_empty",          cc_function_val_is_empty);
-  defineNative("val_is_string",         cc_function_val_is_string);
-  defineNative("val_is_number",         cc_function_val_is_number);
-  defineNative("val_is_boolean",        cc_function_val_is_boolean);
-  defineNative("val_is_array",          cc_function_val_is_array);
-  defineNative("val_is_hash",           cc_function_val_is_hash);
-  defineNative("val_is_filehandle",     cc_function_val_is_filehandle);
-  defineNative("val_is_nan",            cc_function_val_is_nan);
-  defineNative("val_is_infinity",       cc_function_val_is_infinity);
+  defineNative("debug_dump_stack",               cc_function_debug_dump_stack);
+  defineNativeSignature("debug_dump_value_hash", cc_function_debug_dump_value_hash, 1, 1, "*");
+  defineNativeSignature("debug_memory_stats",    cc_function_debug_memory_stats,    0, 0, "");
+  defineNative("time",                           cc_function_time);
+  defineNativeSignature("environment_getvar",    cc_function_environment_getvar,    1, 1, "s");
+  defineNative("environment_arguments",          cc_function_environment_arguments);
+
+
+
+  defineNativeSignature("val_is_empty",      cc_function_val_is_empty,      1, 1, "*");
+  defineNativeSignature("val_is_string",     cc_function_val_is_string,     1, 1, "*");
+  defineNativeSignature("val_is_number",     cc_function_val_is_number,     1, 1, "*");
+  defineNativeSignature("val_is_boolean",    cc_function_val_is_boolean,    1, 1, "*");
+  defineNativeSignature("val_is_array",      cc_function_val_is_array,      1, 1, "*");
+  defineNativeSignature("val_is_hash",       cc_function_val_is_hash,       1, 1, "*");
+  defineNativeSignature("val_is_filehandle", cc_function_val_is_filehandle, 1, 1, "*");
+  defineNativeSignature("val_is_filemap",    cc_function_val_is_filemap,    1, 1, "*");
+  defineNativeSignature("val_is_nan",        cc_function_val_is_nan,        1, 1, "*");
+  defineNativeSignature("val_is_infinity",   cc_function_val_is_infinity,   1, 1, "*");
 
   cc_register_ext_number();
   cc_register_ext_string();
   cc_register_ext_file();
+  cc_register_ext_filemap();
   cc_register_ext_process();
+  cc_register_ext_io();
 }
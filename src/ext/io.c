@@ -0,0 +1,332 @@
+/*
+    An epoll() event loop for reading many filehandles at once, like the
+    stdout and stderr of a bunch of processes started with process_open().
+
+    io_watch() puts a readable handle in non-blocking mode and registers a
+    callback for it.  Each io_poll() waits for any watched handle to become
+    readable, drains whatever is waiting on it into that handle's buffer, and
+    hands the callback every complete line.  At the end of the file the
+    callback gets whatever is left over as a last line, then false, and the
+    handle stops being watched.
+
+    The loop reads from the file descriptor, not through stdio.  Anything
+    stdio has already buffered for the handle won't be seen, so a watched
+    handle shouldn't also be read with fh_read_line() and friends.
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#include "../common.h"
+#include "../memory.h"
+#include "../vm.h"
+
+#include "io.h"
+#include "ferrors.h"
+
+// How much io_poll() asks read() for at a time.
+#define IO_READ_SIZE (64 * 1024)
+// How much io_poll() takes from one handle before moving on to the next, so a
+// chatty process can't starve the others.  epoll will report it again.
+#define IO_FILL_MAX (1024 * 1024)
+// How many ready handles one io_poll() can pick up.
+#define IO_EVENTS_MAX 64
+
+typedef struct {
+    // Tells this watch apart from a later one for the same handle.
+    uint64_t id;
+    ObjFileHandle* fh;
+    Value callback;
+    // Bytes read but not yet handed to the callback, always a partial line
+    // between polls.
+    char* buffer;
+    size_t length;
+    size_t capacity;
+} IO_Watch;
+
+static int io_epoll_fd = -1;
+static IO_Watch** io_watches = NULL;
+static int io_watches_count = 0;
+static int io_watches_capacity = 0;
+static uint64_t io_next_id = 0;
+
+
+// There are rarely more than a few dozen watches, so they're just searched.
+static int io_find(ObjFileHandle* fh) {
+    for(int i = 0; i < io_watches_count; i++) {
+        if(io_watches[i]->fh == fh) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+static IO_Watch* io_find_fd(int fd) {
+    for(int i = 0; i < io_watches_count; i++) {
+        if(fileno(io_watches[i]->fh->handle) == fd) {
+            return io_watches[i];
+        }
+    }
+    return NULL;
+}
+
+
+static void io_set_blocking(int fd, bool blocking) {
+    int flags = fcntl(fd, F_GETFL);
+    if(flags >= 0) {
+        fcntl(fd, F_SETFL, blocking ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK));
+    }
+}
+
+
+// Stops watching the handle, which goes back to blocking reads.  Returns false
+// if it wasn't being watched.
+bool cc_io_unwatch(ObjFileHandle* fh) {
+    int index = io_find(fh);
+    if(index < 0) {
+        return false;
+    }
+    IO_Watch* watch = io_watches[index];
+    int fd = fileno(fh->handle);
+    epoll_ctl(io_epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+    io_set_blocking(fd, true);
+
+    io_watches[index] = io_watches[--io_watches_count];
+    FREE_ARRAY(char, watch->buffer, watch->capacity);
+    FREE(IO_Watch, watch);
+    return true;
+}
+
+
+/**
+ * io_watch(fh, callback)
+ * - returns false if the handle isn't open for reading
+ * - returns true once the handle is being watched.  Watching a handle again
+ *   just replaces its callback.
+ *
+ * => callback(line, fh)
+ * - line includes its newline, except maybe for the last one.  It's false
+ *   once the end of the file has been reached.
+ */
+Value cc_function_io_watch(int arg_count, Value* args) {
+    ObjFileHandle* fh = AS_FILEHANDLE(args[0]);
+    if(!fh->is_reader || !fh->is_open) {
+        return BOOL_VAL(false);
+    }
+    int index = io_find(fh);
+    if(index >= 0) {
+        io_watches[index]->callback = args[1];
+        return BOOL_VAL(true);
+    }
+
+    // Make room first, so running out of memory leaves nothing to undo.
+    if(io_watches_count == io_watches_capacity) {
+        int capacity = GROW_CAPACITY(io_watches_capacity);
+        IO_Watch** watches = GROW_ARRAY(io_watches, IO_Watch*, io_watches_capacity, capacity);
+        if(watches == NULL) {
+            return FERROR_VAL(FE_OUT_OF_MEMORY);
+        }
+        io_watches = watches;
+        io_watches_capacity = capacity;
+    }
+    IO_Watch* watch = ALLOCATE(IO_Watch, 1);
+    if(watch == NULL) {
+        return FERROR_VAL(FE_OUT_OF_MEMORY);
+    }
+
+    if(io_epoll_fd < 0) {
+        io_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if(io_epoll_fd < 0) {
+            int old_errno = errno;
+            FREE(IO_Watch, watch);
+            return FERROR_ERRNO_VAL(FE_IO_EPOLL_FAILED, old_errno);
+        }
+    }
+    int fd = fileno(fh->handle);
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if(epoll_ctl(io_epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+        int old_errno = errno;
+        FREE(IO_Watch, watch);
+        return FERROR_ERRNO_VAL(FE_IO_EPOLL_FAILED, old_errno);
+    }
+    io_set_blocking(fd, false);
+
+    watch->id = io_next_id++;
+    watch->fh = fh;
+    watch->callback = args[1];
+    watch->buffer = NULL;
+    watch->length = 0;
+    watch->capacity = 0;
+    io_watches[io_watches_count++] = watch;
+    return BOOL_VAL(true);
+}
+
+
+/**
+ * io_unwatch(fh)
+ * - returns true if the handle was being watched, false otherwise
+ * - any partial line read from the handle is thrown away
+ */
+Value cc_function_io_unwatch(int arg_count, Value* args) {
+    return BOOL_VAL(cc_io_unwatch(AS_FILEHANDLE(args[0])));
+}
+
+
+/**
+ * io_watch_count()
+ * - returns the number of handles being watched, so a loop can keep calling
+ *   io_poll() until every handle has reached the end of its file
+ */
+Value cc_function_io_watch_count(int arg_count, Value* args) {
+    return NUMBER_VAL(io_watches_count);
+}
+
+
+// Reads what the handle has ready, up to IO_FILL_MAX, onto the end of its
+// buffer.  Returns 1 if there may be more later, 0 at the end of the file,
+// and -1 with errno set on error.
+static int io_fill(IO_Watch* watch) {
+    int fd = fileno(watch->fh->handle);
+    size_t filled = 0;
+    while(filled < IO_FILL_MAX) {
+        if(watch->capacity - watch->length < IO_READ_SIZE) {
+            size_t capacity = watch->length + IO_READ_SIZE;
+            char* buffer = GROW_ARRAY(watch->buffer, char, watch->capacity, capacity);
+            if(buffer == NULL) {
+                errno = ENOMEM;
+                return -1;
+            }
+            watch->buffer = buffer;
+            watch->capacity = capacity;
+        }
+        ssize_t res = read(fd, watch->buffer + watch->length, IO_READ_SIZE);
+        if(res > 0) {
+            watch->length += res;
+            filled += res;
+            continue;
+        }
+        if(res == 0) {
+            return 0;
+        }
+        if(errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 1;
+        }
+        if(errno != EINTR) {
+            return -1;
+        }
+    }
+    return 1;
+}
+
+
+// Calls the handle's callback once per complete line in its buffer, and with
+// the remainder and then false at the end of the file.  Each line is taken out
+// of the buffer before its callback runs, and the watch is looked up again
+// after, because the callback can unwatch the handle (and even watch it again).
+// Returns false if a callback failed with a runtime error.
+static bool io_dispatch(IO_Watch* watch, bool at_eof) {
+    ObjFileHandle* fh = watch->fh;
+    uint64_t id = watch->id;
+    int64_t frame_count = vm.frameCount;
+    size_t start = 0;
+    for(;;) {
+        int index = io_find(fh);
+        if(index < 0 || io_watches[index]->id != id) {
+            return true;
+        }
+        watch = io_watches[index];
+
+        Value line;
+        char* newline = memchr(watch->buffer + start, '\n', watch->length - start);
+        if(newline != NULL) {
+            size_t end = newline - watch->buffer + 1;
+            line = OBJ_VAL(copyUninternedString(watch->buffer + start, end - start));
+            start = end;
+        } else {
+            // Keep the partial line for the next poll.
+            memmove(watch->buffer, watch->buffer + start, watch->length - start);
+            watch->length -= start;
+            start = 0;
+            if(!at_eof) {
+                return true;
+            }
+            if(watch->length > 0) {
+                line = OBJ_VAL(copyUninternedString(watch->buffer, watch->length));
+                watch->length = 0;
+            } else {
+                line = BOOL_VAL(false);
+                at_eof = false;
+            }
+        }
+
+        Value callback_args[2] = { line, OBJ_VAL(fh) };
+        callCallback(watch->callback, 2, callback_args);
+        if(vm.frameCount < frame_count) {
+            return false;
+        }
+        if(IS_BOOL(line)) {
+            // That was the end of the file.
+            cc_io_unwatch(fh);
+            return true;
+        }
+    }
+}
+
+
+/**
+ * io_poll(timeout_ms?)
+ * - returns the number of handles that were ready, which is 0 if the timeout
+ *   passed first or nothing is being watched
+ * - waits for up to timeout_ms milliseconds, or for as long as it takes if
+ *   the timeout is missing or negative
+ */
+Value cc_function_io_poll(int arg_count, Value* args) {
+    if(io_watches_count == 0) {
+        return NUMBER_VAL(0);
+    }
+    int timeout = -1;
+    if(arg_count == 1 && AS_NUMBER(args[0]) >= 0) {
+        timeout = AS_NUMBER(args[0]) < 2147483647 ? (int)AS_NUMBER(args[0]) : 2147483647;
+    }
+
+    struct epoll_event events[IO_EVENTS_MAX];
+    int ready = epoll_wait(io_epoll_fd, events, IO_EVENTS_MAX, timeout);
+    if(ready < 0) {
+        if(errno == EINTR) {
+            return NUMBER_VAL(0);
+        }
+        return FERROR_AUTOERRNO_VAL(FE_IO_EPOLL_FAILED);
+    }
+
+    for(int i = 0; i < ready; i++) {
+        // An earlier callback may have unwatched this one.
+        IO_Watch* watch = io_find_fd(events[i].data.fd);
+        if(watch == NULL) {
+            continue;
+        }
+        int res = io_fill(watch);
+        if(res < 0) {
+            int old_errno = errno;
+            cc_io_unwatch(watch->fh);
+            return FERROR_ERRNO_VAL(FE_IO_READ_FAILED, old_errno);
+        }
+        if(!io_dispatch(watch, res == 0)) {
+            return NIL_VAL;
+        }
+    }
+    return NUMBER_VAL(ready);
+}
+
+
+void cc_register_ext_io() {
+    defineNativeSignature("io_watch",       cc_function_io_watch,       2, 2, "fc");
+    defineNativeSignature("io_unwatch",     cc_function_io_unwatch,     1, 1, "f");
+    defineNativeSignature("io_watch_count", cc_function_io_watch_count, 0, 0, "");
+    defineNativeSignature("io_poll",        cc_function_io_poll,        0, 1, "n");
+}
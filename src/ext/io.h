@@ -0,0 +1,9 @@
+#ifndef cc_ext_io_h
+#define cc_ext_io_h
+
+#include "../object.h"
+
+bool cc_io_unwatch(ObjFileHandle* fh);
+void cc_register_ext_io();
+
+#endif
@@ -10,18 +10,11 @@
 
 
 Value cc_function_number_absolute(int arg_count, Value* args) {
-  if (arg_count != 1 || !IS_NUMBER(args[0])) {
-    return FERROR_VAL(FE_ARG_1_NUMBER);
-  }
   return NUMBER_VAL(fabs(AS_NUMBER(args[0])));
 }
 
 
 Value cc_function_number_remainder(int arg_count, Value* args) {
-  if (arg_count != 2) { return FERROR_VAL(FE_ARG_COUNT_2); }
-  if (!IS_NUMBER(args[0])) { return FERROR_VAL(FE_ARG_1_NUMBER); }
-  if (!IS_NUMBER(args[1])) { return FERROR_VAL(FE_ARG_2_NUMBER); }
-
   // Problem: We're trying to get the integer remainder of an integer division,
   // but the data types are doubles that may contain decimal numbers.
   // Solution: trunc() is used to round the value stored in the doubles towards
@@ -43,9 +36,6 @@ Value cc_function_number_remainder(int arg_count, Value* args) {
 
 
 Value cc_function_number_minimum(int arg_count, Value* args) {
-  if (arg_count < 1) {
-    return FERROR_VAL(FE_ARG_GTE_1);
-  }
   double minimum_value = INFINITY;
   for (int i = 0; i < arg_count; i++) {
     if (IS_NUMBER(args[i]) && AS_NUMBER(args[i]) < minimum_value) {
@@ -57,9 +47,6 @@ Value cc_function_number_minimum(int arg_count, Value* args) {
 
 
 Value cc_function_number_maximum(int arg_count, Value* args) {
-  if (arg_count < 1) {
-    return FERROR_VAL(FE_ARG_GTE_1);
-  }
   double maximum_value = -INFINITY;
   for (int i = 0; i < arg_count; i++) {
     if (IS_NUMBER(args[i]) && AS_NUMBER(args[i]) > maximum_value) {
@@ -71,26 +58,16 @@ Value cc_function_number_maximum(int arg_count, Value* args) {
 
 
 Value cc_function_number_floor(int arg_count, Value* args) {
-  if (arg_count != 1 || !IS_NUMBER(args[0])) {
-    return FERROR_VAL(FE_ARG_1_NUMBER);
-  }
   return NUMBER_VAL(floor(AS_NUMBER(args[0])));
 }
 
 
 Value cc_function_number_ceiling(int arg_count, Value* args) {
-  if (arg_count != 1 || !IS_NUMBER(args[0])) {
-    return FERROR_VAL(FE_ARG_1_NUMBER);
-  }
   return NUMBER_VAL(ceil(AS_NUMBER(args[0])));
 }
 
 
 Value cc_function_number_round(int arg_count, Value* args) {
-  if (arg_count < 1 || !IS_NUMBER(args[0])) { return FERROR_VAL(FE_ARG_1_NUMBER); }
-  if (arg_count == 2 && !IS_NUMBER(args[1])) { return FERROR_VAL(FE_ARG_2_NUMBER); }
-  if (arg_count > 2) { return FERROR_VAL(FE_ARG_COUNT_1_2); }
-
   // We'll optionally be passed a precision argument, which may be a positive
   // or negative integer.  Our stdlib functions only operate on integers.
   // We can simulate the requested precision by shifting the decimal place in
@@ -124,11 +101,6 @@ Value cc_function_number_round(int arg_count, Value* args) {
 
 
 Value cc_function_number_clamp(int arg_count, Value* args) {
-  if (arg_count != 3) { return FERROR_VAL(FE_ARG_COUNT_3); }
-  if (!IS_NUMBER(args[0])) { return FERROR_VAL(FE_ARG_1_NUMBER); }
-  if (!IS_NUMBER(args[1])) { return FERROR_VAL(FE_ARG_2_NUMBER); }
-  if (!IS_NUMBER(args[2])) { return FERROR_VAL(FE_ARG_3_NUMBER); }
-
   double value = AS_NUMBER(args[0]);
   double minimum = AS_NUMBER(args[1]);
   double maximum = AS_NUMBER(args[2]);
@@ -143,9 +115,6 @@ Value cc_function_number_clamp(int arg_count, Value* args) {
 
 
 Value cc_function_number_to_string(int arg_count, Value* args) {
-  if (arg_count != 1 || !IS_NUMBER(args[0])) {
-    return FERROR_VAL(FE_ARG_1_NUMBER);
-  }
   double number = AS_NUMBER(args[0]);
   // Oh how I loathe manual memory management!
   // Taking this tip from: https://stackoverflow.com/a/3923207/16886
@@ -163,9 +132,6 @@ Value cc_function_number_to_string(int arg_count, Value* args) {
 
 
 Value cc_function_number_to_hex_string(int arg_count, Value* args) {
-  if (arg_count != 1 || !IS_NUMBER(args[0])) {
-    return FERROR_VAL(FE_ARG_1_NUMBER);
-  }
   double raw_number = AS_NUMBER(args[0]);
   // The method we're going to use to hexify this number can't take negatives.
   if (raw_number < 0 || isnan(raw_number) || isinf(raw_number)) {
@@ -211,24 +177,20 @@ double random_int(double left, double right) {
 
 
 Value cc_function_number_random(int arg_count, Value* args) {
-  if (arg_count != 2) { return FERROR_VAL(FE_ARG_COUNT_2); }
-  if (!IS_NUMBER(args[0])) { return FERROR_VAL(FE_ARG_1_NUMBER); }
-  if (!IS_NUMBER(args[1])) { return FERROR_VAL(FE_ARG_2_NUMBER); }
-
   return NUMBER_VAL( random_int( AS_NUMBER(args[0]), AS_NUMBER(args[1]) ) );
 }
 
 
 void cc_register_ext_number() {
-  defineNative("number_absolute",       cc_function_number_absolute);
-  defineNative("number_remainder",      cc_function_number_remainder);
-  defineNative("number_minimum",        cc_function_number_minimum);
-  defineNative("number_maximum",        cc_function_number_maximum);
-  defineNative("number_floor",          cc_function_number_floor);
-  defineNative("number_ceiling",        cc_function_number_ceiling);
-  defineNative("number_round",          cc_function_number_round);
-  defineNative("number_clamp",          cc_function_number_clamp);
-  defineNative("number_to_string",      cc_function_number_to_string);
-  defineNative("number_to_hex_string",  cc_function_number_to_hex_string);
-  defineNative("number_random",         cc_function_number_random);
+  defineNativeSignature("number_absolute",      cc_function_number_absolute,      1, 1, "n");
+  defineNativeSignature("number_remainder",     cc_function_number_remainder,     2, 2, "nn");
+  defineNativeSignature("number_minimum",       cc_function_number_minimum,       1, NATIVE_VARIADIC, "");
+  defineNativeSignature("number_maximum",       cc_function_number_maximum,       1, NATIVE_VARIADIC, "");
+  defineNativeSignature("number_floor",         cc_function_number_floor,         1, 1, "n");
+  defineNativeSignature("number_ceiling",       cc_function_number_ceiling,       1, 1, "n");
+  defineNativeSignature("number_round",         cc_function_number_round,         1, 2, "nn");
+  defineNativeSignature("number_clamp",         cc_function_number_clamp,         3, 3, "nnn");
+  defineNativeSignature("number_to_string",     cc_function_number_to_string,     1, 1, "n");
+  defineNativeSignature("number_to_hex_string", cc_function_number_to_hex_string, 1, 1, "n");
+  defineNativeSignature("number_random",        cc_function_number_random,        2, 2, "nn");
 }
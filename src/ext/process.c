@@ -1,5 +1,9 @@
 #include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
 #include <unistd.h>
+#include <poll.h>
+#include <spawn.h>
 #include <sys/wait.h>
 #include <signal.h>
 
@@ -10,12 +14,13 @@
 #include "./ferrors.h"
 #include "./userarray.h"
 
+// The most children process_run_many() will run at once.
+#define PR_PARALLEL_MAX 256
+
+extern char** environ;
 
-Value cc_function_process_open(int arg_count, Value* args) {
-    if (arg_count < 1 || arg_count > 2) { return FERROR_VAL(FE_ARG_COUNT_1_2); }
-    if (!IS_STRING(args[0])) { return FERROR_VAL(FE_ARG_1_STRING); }
-    if (arg_count == 2 && !IS_USERARRAY(args[1])) { return FERROR_VAL(FE_ARG_2_ARRAY); }
 
+Value cc_function_process_open(int arg_count, Value* args) {
     ObjString* command = AS_STRING(args[0]);
     ObjUserArray* command_args;
     int cmd_size = 1;
@@ -67,6 +72,13 @@ Value cc_function_process_open(int arg_count, Value* args) {
         if(stderr_errno) { return FERROR_ERRNO_VAL(FE_PROCESS_PIPE_CREATE_FAILED, stderr_errno); }
     }
 
+    // The ends we keep are close-on-exec, so processes started later don't
+    // inherit them.  Otherwise closing this one's stdin wouldn't reach it as
+    // the end of the file until every process started after it had exited.
+    fcntl(stdin_pipe[WRITING_END], F_SETFD, FD_CLOEXEC);
+    fcntl(stdout_pipe[READING_END], F_SETFD, FD_CLOEXEC);
+    fcntl(stderr_pipe[READING_END], F_SETFD, FD_CLOEXEC);
+
     int pid = fork();
     if(pid > 0) {
         // We're in the parent post-fork.  Close our connections to the wrong
@@ -126,9 +138,6 @@ Value cc_function_process_open(int arg_count, Value* args) {
 
 
 Value cc_function_process_close(int arg_count, Value* args) {
-    if(arg_count != 1) { return FERROR_VAL(FE_ARG_COUNT_1); }
-    if(!IS_NUMBER(args[0])) { return FERROR_VAL(FE_ARG_1_NUMBER); }
-
     int pid = AS_NUMBER(args[0]);
     int status = 0;
     int res = waitpid(pid, &status, WNOHANG);
@@ -166,7 +175,251 @@ Value cc_function_process_close(int arg_count, Value* args) {
 }
 
 
+// One child of process_run_many(), and everything it has written so far.
+typedef struct {
+    int64_t index;
+    pid_t pid;
+    // The reading ends of its stdout and stderr, or -1 once they're closed.
+    int fds[2];
+    char* output[2];
+    size_t length[2];
+    size_t capacity[2];
+} PR_Child;
+
+
+static bool pr_pipe(int fds[2]) {
+    if(pipe(fds) != 0) {
+        return false;
+    }
+    // Neither end should leak into any other child.  The child's own end is
+    // put in place with dup2(), which clears the flag on the copy.
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return true;
+}
+
+
+// Starts the command with stdin from /dev/null and stdout and stderr going to
+// new pipes.  Returns 0 or an errno value.
+static int pr_spawn(PR_Child* child, ObjUserArray* command) {
+    int64_t argc = command->inner.count;
+    char** argv = ALLOCATE(char*, argc + 1);
+    if(argv == NULL) {
+        return ENOMEM;
+    }
+    for(int64_t i = 0; i < argc; i++) {
+        argv[i] = AS_CSTRING(command->inner.values[i]);
+    }
+    argv[argc] = NULL;
+
+    int out_pipe[2];
+    int err_pipe[2];
+    if(!pr_pipe(out_pipe)) {
+        int old_errno = errno;
+        FREE_ARRAY(char*, argv, argc + 1);
+        return old_errno;
+    }
+    if(!pr_pipe(err_pipe)) {
+        int old_errno = errno;
+        close(out_pipe[0]);
+        close(out_pipe[1]);
+        FREE_ARRAY(char*, argv, argc + 1);
+        return old_errno;
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, 0, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, out_pipe[1], 1);
+    posix_spawn_file_actions_adddup2(&actions, err_pipe[1], 2);
+    // Looks the program up in the PATH, the same as process_open()'s execvp().
+    int res = posix_spawnp(&child->pid, argv[0], &actions, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    FREE_ARRAY(char*, argv, argc + 1);
+
+    close(out_pipe[1]);
+    close(err_pipe[1]);
+    if(res != 0) {
+        close(out_pipe[0]);
+        close(err_pipe[0]);
+        return res;
+    }
+    child->fds[0] = out_pipe[0];
+    child->fds[1] = err_pipe[0];
+    return 0;
+}
+
+
+// Reads whatever is waiting on one of the child's pipes, closing it at the end
+// of the file.  Returns false if there's no memory left to read into.
+static bool pr_drain(PR_Child* child, int stream) {
+    if(child->capacity[stream] - child->length[stream] < 4096) {
+        size_t capacity = child->capacity[stream] < 4096 ? 8192 : child->capacity[stream] * 2;
+        char* output = GROW_ARRAY(child->output[stream], char, child->capacity[stream], capacity);
+        if(output == NULL) {
+            return false;
+        }
+        child->output[stream] = output;
+        child->capacity[stream] = capacity;
+    }
+    ssize_t res = read(
+        child->fds[stream], child->output[stream] + child->length[stream],
+        child->capacity[stream] - child->length[stream]
+    );
+    if(res > 0) {
+        child->length[stream] += res;
+    } else if(res == 0 || errno != EINTR) {
+        close(child->fds[stream]);
+        child->fds[stream] = -1;
+    }
+    return true;
+}
+
+
+static Value pr_result(bool exited, int code, char* output, size_t length, char* errors, size_t errors_length) {
+    ObjUserArray* result = newUserArray();
+    ua_grow(result, 4);
+    result->inner.values[0] = BOOL_VAL(exited);
+    result->inner.values[1] = NUMBER_VAL(code);
+    result->inner.values[2] = OBJ_VAL(copyUninternedString(output == NULL ? "" : output, length));
+    result->inner.values[3] = OBJ_VAL(copyUninternedString(errors == NULL ? "" : errors, errors_length));
+    result->inner.count = 4;
+    return OBJ_VAL(result);
+}
+
+
+// Waits for a child whose pipes have both closed and records how it went.
+static void pr_finish(PR_Child* child, ObjUserArray* results) {
+    int status = 0;
+    while(waitpid(child->pid, &status, 0) < 0 && errno == EINTR);
+    // The same thing process_close() reports: true and the exit status for a
+    // normal exit, false and the signal for one that was killed.
+    bool exited = WIFEXITED(status);
+    results->inner.values[child->index] = pr_result(
+        exited, exited ? WEXITSTATUS(status) : WTERMSIG(status),
+        child->output[0], child->length[0], child->output[1], child->length[1]
+    );
+    FREE_ARRAY(char, child->output[0], child->capacity[0]);
+    FREE_ARRAY(char, child->output[1], child->capacity[1]);
+}
+
+
+// Kills and reaps the children still running when process_run_many() has to
+// give up, so they don't outlive it as zombies holding their pipes open.
+static void pr_abandon(PR_Child* running, int running_count) {
+    for(int i = 0; i < running_count; i++) {
+        PR_Child* child = &running[i];
+        kill(child->pid, SIGKILL);
+        while(waitpid(child->pid, NULL, 0) < 0 && errno == EINTR);
+        for(int stream = 0; stream < 2; stream++) {
+            if(child->fds[stream] >= 0) {
+                close(child->fds[stream]);
+            }
+            FREE_ARRAY(char, child->output[stream], child->capacity[stream]);
+        }
+    }
+}
+
+
+/**
+ * process_run_many(commands, max_parallel?)
+ * - returns an array with one result per command, in the same order
+ * - each command is an array of strings: the program, then its arguments.
+ *   Programs are looked up in the PATH.
+ * - runs up to max_parallel commands at once, or one per online CPU if it's
+ *   missing, with stdin from /dev/null and stdout and stderr captured
+ * - each result is [exited, status, stdout, stderr], where exited and status
+ *   are what process_close() would return.  A command that can't be started
+ *   at all gets an exit status of 127 and the reason as its stderr.
+ */
+Value cc_function_process_run_many(int arg_count, Value* args) {
+    ObjUserArray* commands = AS_USERARRAY(args[0]);
+    for(int64_t i = 0; i < commands->inner.count; i++) {
+        Value command = commands->inner.values[i];
+        if(!IS_USERARRAY(command) || AS_USERARRAY(command)->inner.count == 0) {
+            return FERROR_VAL(FE_PROCESS_BAD_COMMAND);
+        }
+        for(int64_t j = 0; j < AS_USERARRAY(command)->inner.count; j++) {
+            if(!IS_STRING(AS_USERARRAY(command)->inner.values[j])) {
+                return FERROR_VAL(FE_PROCESS_BAD_COMMAND);
+            }
+        }
+    }
+
+    int max_parallel = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if(arg_count == 2 && AS_NUMBER(args[1]) >= 1) {
+        max_parallel = AS_NUMBER(args[1]) < PR_PARALLEL_MAX ? (int)AS_NUMBER(args[1]) : PR_PARALLEL_MAX;
+    }
+    if(max_parallel < 1) {
+        max_parallel = 1;
+    }
+    if(max_parallel > PR_PARALLEL_MAX) {
+        max_parallel = PR_PARALLEL_MAX;
+    }
+
+    ObjUserArray* results = newUserArray();
+    ua_grow(results, commands->inner.count);
+    results->inner.count = commands->inner.count;
+
+    PR_Child running[PR_PARALLEL_MAX];
+    struct pollfd fds[PR_PARALLEL_MAX * 2];
+    int running_count = 0;
+    int64_t next = 0;
+    while(next < commands->inner.count || running_count > 0) {
+        // Keep every slot busy.
+        while(running_count < max_parallel && next < commands->inner.count) {
+            PR_Child* child = &running[running_count];
+            memset(child, 0, sizeof(PR_Child));
+            child->index = next;
+            int res = pr_spawn(child, AS_USERARRAY(commands->inner.values[next]));
+            if(res != 0) {
+                const char* reason = strerror(res);
+                results->inner.values[next] = pr_result(true, 127, NULL, 0, (char*)reason, strlen(reason));
+            } else {
+                running_count++;
+            }
+            next++;
+        }
+        if(running_count == 0) {
+            continue;
+        }
+
+        int fd_count = 0;
+        for(int i = 0; i < running_count; i++) {
+            for(int stream = 0; stream < 2; stream++) {
+                fds[fd_count].fd = running[i].fds[stream];
+                fds[fd_count].events = POLLIN;
+                fds[fd_count].revents = 0;
+                fd_count++;
+            }
+        }
+        if(poll(fds, fd_count, -1) < 0 && errno != EINTR) {
+            int old_errno = errno;
+            pr_abandon(running, running_count);
+            return FERROR_ERRNO_VAL(FE_PROCESS_POLL_FAILED, old_errno);
+        }
+
+        // Walk backwards so finished children can be replaced by the last one.
+        for(int i = running_count - 1; i >= 0; i--) {
+            PR_Child* child = &running[i];
+            for(int stream = 0; stream < 2; stream++) {
+                if(fds[i * 2 + stream].revents != 0 && !pr_drain(child, stream)) {
+                    pr_abandon(running, running_count);
+                    return FERROR_VAL(FE_OUT_OF_MEMORY);
+                }
+            }
+            if(child->fds[0] < 0 && child->fds[1] < 0) {
+                pr_finish(child, results);
+                running[i] = running[--running_count];
+            }
+        }
+    }
+    return OBJ_VAL(results);
+}
+
+
 void cc_register_ext_process() {
-    defineNative("process_open",  cc_function_process_open);
-    defineNative("process_close", cc_function_process_close);
+    defineNativeSignature("process_open",  cc_function_process_open,  1, 2, "sa");
+    defineNativeSignature("process_close", cc_function_process_close, 1, 1, "n");
+    defineNativeSignature("process_run_many", cc_function_process_run_many, 1, 2, "an");
 }
@@ -1,3 +1,6 @@
+// For memmem().
+#define _GNU_SOURCE
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -11,12 +14,15 @@
 #include "userarray.h"
 #include "ferrors.h"
 
-static int16_t st_normalize_index(ObjString* str, double raw_index) {
-  // ObjString's length is held in an int, which is apparently 16 bits?
-  if(raw_index > INT16_MAX || raw_index < INT16_MIN) {
+// Indexes and ranges arrive as doubles.  They are checked against the length
+// of the string before they are converted, so a huge or NaN double can never
+// land in an integer that can't hold it.
+static int64_t st_normalize_index(ObjString* str, double raw_index) {
+  double truncated_index = trunc(raw_index);
+  if(!(truncated_index >= -(double)str->length && truncated_index < (double)str->length)) {
     return -1;
   }
-  int16_t target_index = (int16_t)raw_index;
+  int64_t target_index = (int64_t)truncated_index;
   // Given a string length of 8 and a starting index of -5,
   // (-5) + 8 = 3
   // [0]  [1]  [2]  [3]  [4]  [5]  [6]  [7]
@@ -24,42 +30,35 @@ static int16_t st_normalize_index(ObjString* str, double raw_index) {
   if(target_index < 0) {
     target_index += str->length;
   }
-  // Most of the time we should be inside the string.
-  if(target_index >= 0 && target_index < str->length) {
-    return target_index;
-  }
-  // The target index will always be positive, so returning -1 will always raise
-  // an error, not refer to index -1.
-  return -1;
+  return target_index;
 }
 
 
-static int16_t st_normalize_range(ObjString* str, int16_t index, double raw_range) {
-  if(raw_range > INT16_MAX || raw_range < INT16_MIN) {
+static int64_t st_normalize_range(ObjString* str, int64_t index, double raw_range) {
+  if(isnan(raw_range)) {
     // @FIXME This is an error, but there's no way of reporting it.  Returning a
     // range of zero is going to have to do for now.
     return 0;
   }
-  int16_t range = (int16_t)raw_range;
   // Given a string length of 8 and a starting index of 3, the maximum positive
   // range is 5, and the maximum negative range is -4.
   // Yes, range includes the index.
-  int16_t span = index + range;
-  if(span > str->length) {
+  double span = (double)index + trunc(raw_range);
+  if(span > (double)str->length) {
     // The range is too high.  Clamp it to the end of the string.
-    range = str->length - index;
+    return str->length - index;
   } else if(span < 0) {
     // The negative range would wrap if it could, but it can't.  Clamp it to the
     // start of the string instead.
-    range = index * -1;
+    return index * -1;
   }
-  return range;
+  return (int64_t)trunc(raw_range);
 }
 
 
 struct ST_Legal_Range {
-    int16_t index;
-    int16_t range;
+    int64_t index;
+    int64_t range;
     bool error;
 };
 
@@ -86,36 +85,179 @@ static struct ST_Legal_Range st_normalize_index_range(
 }
 
 
-static Value str_indexof_core(ObjString* haystack, ObjString* needle, int16_t starting_index) {
-  int16_t maximum_index = haystack->length - needle->length;
-  for(int index = starting_index; index <= maximum_index; index++) {
-    if(haystack->chars[index] == needle->chars[0]) {
-      // Yes, memcmp() returns 0 when left and right are identical.
-      if(memcmp(&haystack->chars[index], needle->chars, needle->length) == 0) {
-        return NUMBER_VAL(index);
+/*
+    Substring search.  On x86-64, needles of up to ST_SIMD_NEEDLE_MAX bytes are
+    found by comparing 16 (SSE2) or 32 (AVX2) candidate positions at a time
+    against the first and the last byte of the needle, and only running
+    memcmp() where both match.  That filter almost never lets a false match
+    through on real text, so it runs at close to memchr() speed.  AVX2 is
+    used when the CPU has it, which is checked once at the first search.
+
+    Single bytes go to memchr(), and longer needles and other platforms go to
+    memmem(), which glibc implements with the Two-Way algorithm.  tcc can't
+    compile the intrinsics, so it always takes that path.
+*/
+#define ST_SIMD_NEEDLE_MAX 256
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__TINYC__)
+#define ST_SIMD
+#include <immintrin.h>
+#endif
+
+typedef int64_t (*ST_Find_Fn)(const char*, int64_t, const char*, int64_t);
+
+
+static int64_t st_find_portable(
+  const char* haystack, int64_t haystack_length, const char* needle, int64_t needle_length
+) {
+  const char* found = memmem(haystack, haystack_length, needle, needle_length);
+  return found == NULL ? -1 : found - haystack;
+}
+
+
+#ifdef ST_SIMD
+
+// Finishes a search the vector loops couldn't, because a full block would
+// read past the end of the haystack.
+static int64_t st_find_tail(
+  const char* haystack, int64_t haystack_length, const char* needle, int64_t needle_length,
+  int64_t index
+) {
+  int64_t found = st_find_portable(
+    haystack + index, haystack_length - index, needle, needle_length
+  );
+  return found < 0 ? -1 : index + found;
+}
+
+
+static int64_t st_find_sse2(
+  const char* haystack, int64_t haystack_length, const char* needle, int64_t needle_length
+) {
+  const __m128i first = _mm_set1_epi8(needle[0]);
+  const __m128i last = _mm_set1_epi8(needle[needle_length - 1]);
+  int64_t index = 0;
+  for(; index + needle_length - 1 + 16 <= haystack_length; index += 16) {
+    __m128i block_first = _mm_loadu_si128((const __m128i*)(haystack + index));
+    __m128i block_last = _mm_loadu_si128((const __m128i*)(haystack + index + needle_length - 1));
+    uint32_t mask = _mm_movemask_epi8(_mm_and_si128(
+      _mm_cmpeq_epi8(block_first, first), _mm_cmpeq_epi8(block_last, last)
+    ));
+    while(mask != 0) {
+      int bit = __builtin_ctz(mask);
+      if(memcmp(haystack + index + bit + 1, needle + 1, needle_length - 2) == 0) {
+        return index + bit;
       }
+      mask &= mask - 1;
     }
   }
-  return BOOL_VAL(false);
+  return st_find_tail(haystack, haystack_length, needle, needle_length, index);
+}
+
+
+__attribute__((target("avx2")))
+static int64_t st_find_avx2(
+  const char* haystack, int64_t haystack_length, const char* needle, int64_t needle_length
+) {
+  const __m256i first = _mm256_set1_epi8(needle[0]);
+  const __m256i last = _mm256_set1_epi8(needle[needle_length - 1]);
+  int64_t index = 0;
+  for(; index + needle_length - 1 + 32 <= haystack_length; index += 32) {
+    __m256i block_first = _mm256_loadu_si256((const __m256i*)(haystack + index));
+    __m256i block_last = _mm256_loadu_si256((const __m256i*)(haystack + index + needle_length - 1));
+    uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(
+      _mm256_cmpeq_epi8(block_first, first), _mm256_cmpeq_epi8(block_last, last)
+    ));
+    while(mask != 0) {
+      int bit = __builtin_ctz(mask);
+      if(memcmp(haystack + index + bit + 1, needle + 1, needle_length - 2) == 0) {
+        return index + bit;
+      }
+      mask &= mask - 1;
+    }
+  }
+  return st_find_tail(haystack, haystack_length, needle, needle_length, index);
+}
+
+
+static ST_Find_Fn st_find_simd = NULL;
+
+#endif
+
+
+// Where the needle first shows up in the haystack, or -1.  The needle must
+// not be empty.
+int64_t st_find(
+  const char* haystack, int64_t haystack_length, const char* needle, int64_t needle_length
+) {
+  if(needle_length > haystack_length) {
+    return -1;
+  }
+  if(needle_length == 1) {
+    const char* found = memchr(haystack, needle[0], haystack_length);
+    return found == NULL ? -1 : found - haystack;
+  }
+#ifdef ST_SIMD
+  if(needle_length <= ST_SIMD_NEEDLE_MAX) {
+    if(st_find_simd == NULL) {
+      __builtin_cpu_init();
+      st_find_simd = __builtin_cpu_supports("avx2") ? st_find_avx2 : st_find_sse2;
+    }
+    return st_find_simd(haystack, haystack_length, needle, needle_length);
+  }
+#endif
+  return st_find_portable(haystack, haystack_length, needle, needle_length);
+}
+
+
+// Where the needle last shows up in the haystack, or -1.  Scans backwards
+// from the end with memrchr(), so the match nearest the end is the first one
+// found.
+static int64_t st_find_last(
+  const char* haystack, int64_t haystack_length, const char* needle, int64_t needle_length
+) {
+  int64_t candidates = haystack_length - needle_length + 1;
+  while(candidates > 0) {
+    const char* found = memrchr(haystack, needle[0], candidates);
+    if(found == NULL) {
+      return -1;
+    }
+    if(memcmp(found + 1, needle + 1, needle_length - 1) == 0) {
+      return found - haystack;
+    }
+    candidates = found - haystack;
+  }
+  return -1;
+}
+
+
+static Value str_indexof_core(ObjString* haystack, ObjString* needle, int64_t starting_index) {
+  if(needle->length < 1 || starting_index > haystack->length - needle->length) {
+    return BOOL_VAL(false);
+  }
+  int64_t found = st_find(
+    haystack->chars + starting_index, haystack->length - starting_index,
+    needle->chars, needle->length
+  );
+  if(found < 0) {
+    return BOOL_VAL(false);
+  }
+  return NUMBER_VAL(starting_index + found);
 }
 
 
 /**
  * string_length(string)
- * - returns nil on parameter error
+ * - raises an error if the arguments are the wrong number or type
  * - returns the number of characters in the given string
  */
 Value cc_function_string_length(int arg_count, Value* args) {
-  if(!IS_STRING(args[0])) {
-    return FERROR_VAL(FE_ARG_1_STRING);
-  }
   return NUMBER_VAL( AS_STRING(args[0])->length );
 }
 
 
 /**
  * string_substring(string, index, count?)
- * - returns nil on parameter error
+ * - raises an error if the arguments are the wrong number or type
  * - returns false if the given index out of legal range
  * - returns a copy of the given string starting at the given index for up to
  *   count characters.  If count is omitted, then the entire remaining string
@@ -123,11 +265,6 @@ Value cc_function_string_length(int arg_count, Value* args) {
  *   must be inside the legal range.
  */
 Value cc_function_string_substring(int arg_count, Value* args) {
-  if(arg_count < 2 || arg_count > 3) { return FERROR_VAL(FE_ARG_COUNT_2_3); }
-  if(!IS_STRING(args[0])) { return FERROR_VAL(FE_ARG_1_STRING); }
-  if(!IS_NUMBER(args[1])) { return FERROR_VAL(FE_ARG_2_NUMBER); }
-  if(arg_count == 3 && !IS_NUMBER(args[2])) { return FERROR_VAL(FE_ARG_3_NUMBER); }
-
   ObjString* str = AS_STRING(args[0]);
 
   double raw_range = 0;
@@ -140,13 +277,13 @@ Value cc_function_string_substring(int arg_count, Value* args) {
   }
   // Zero range is both our default and the error state, but that's fine.
   // When it's zero, we're just going to take the remainder of the string.
-  int16_t count = legal.range;
+  int64_t count = legal.range;
   if(count == 0) {
     count = str->length - legal.index;
   }
 
   char* new_chars = ALLOCATE(char, 1 + count);
-  for(int i = 0; i < count; i++) {
+  for(int64_t i = 0; i < count; i++) {
     new_chars[i] = str->chars[i + legal.index];
   }
   new_chars[count] = '\0';
@@ -156,23 +293,18 @@ Value cc_function_string_substring(int arg_count, Value* args) {
 
 /**
  * string_split(source_string, delimiter_string, limit?)
- * - returns nil on parameter error
+ * - raises an error if the arguments are the wrong number or type
  * - returns an array composed of the source string broken up by the delimiter.
  *   If a limit is passed, the string will only be split limit times.  The last
  *   element of the array will contain the remainder of the string, including
  *   any remaining delimiters.  Limit must be > 0.
  */
 Value cc_function_string_split(int arg_count, Value* args) {
-  if(arg_count < 2 || arg_count > 3) { return FERROR_VAL(FE_ARG_COUNT_2_3); }
-  if(!IS_STRING(args[0])) { return FERROR_VAL(FE_ARG_1_STRING); }
-  if(!IS_STRING(args[1])) { return FERROR_VAL(FE_ARG_2_STRING); }
-  if(arg_count == 3 && !IS_NUMBER(args[2])) { return FERROR_VAL(FE_ARG_3_NUMBER); }
-
   bool has_limit = false;
-  int16_t limit = 1;
+  double limit = 1;
   if(arg_count == 3) {
     has_limit = true;
-    limit = (int16_t)AS_NUMBER(args[2]);
+    limit = trunc(AS_NUMBER(args[2]));
   }
   if(limit < 1) {
     return FERROR_VAL(FE_STRING_SPLIT_NEGATIVE_LIMIT);
@@ -182,16 +314,16 @@ Value cc_function_string_split(int arg_count, Value* args) {
   ObjString* needle = AS_STRING(args[1]);
   ObjUserArray* container = newUserArray();
 
-  int16_t starting_index = 0;
+  int64_t starting_index = 0;
   while(starting_index < haystack->length) {
-    int16_t start_of_next_delimiter = starting_index;
+    int64_t start_of_next_delimiter = starting_index;
 
     Value res = str_indexof_core(haystack, needle, starting_index);
     if(IS_BOOL(res) && AS_BOOL(res) == false) {
       // The substring was not found.  Take the rest of the string.
       start_of_next_delimiter = haystack->length;
     } else if(IS_NUMBER(res)) {
-      start_of_next_delimiter = (int16_t)AS_NUMBER(res);
+      start_of_next_delimiter = (int64_t)AS_NUMBER(res);
     }
 
     if(has_limit && container->inner.count == limit) {
@@ -199,7 +331,7 @@ Value cc_function_string_split(int arg_count, Value* args) {
       start_of_next_delimiter = haystack->length;
     }
 
-    int16_t new_string_length = start_of_next_delimiter - starting_index;
+    int64_t new_string_length = start_of_next_delimiter - starting_index;
     char* new_string = ALLOCATE(char, new_string_length + 1);
     // Yes, memcpy() takes the destination before the source.
     memcpy(new_string, &haystack->chars[starting_index], new_string_length);
@@ -216,25 +348,20 @@ Value cc_function_string_split(int arg_count, Value* args) {
 
 /**
  * string_index_of(haystack_string, needle_string, starting_index?)
- * - returns nil on parameter error
+ * - raises an error if the arguments are the wrong number or type
  * - returns false if the given index out of legal range
  * - returns the index at which the substring needle_string is found in the
  *   given haystack_string, optionally starting the search at the given index.
  *   Returns false if the substring could not be located.
  */
 Value cc_function_string_index_of(int arg_count, Value* args) {
-  if(arg_count < 2 || arg_count > 3) { return FERROR_VAL(FE_ARG_COUNT_2_3); }
-  if(!IS_STRING(args[0])) { return FERROR_VAL(FE_ARG_1_STRING); }
-  if(!IS_STRING(args[1])) { return FERROR_VAL(FE_ARG_2_STRING); }
-  if(arg_count == 3 && !IS_NUMBER(args[2])) { return FERROR_VAL(FE_ARG_3_NUMBER); }
-
   ObjString* haystack = AS_STRING(args[0]);
   ObjString* needle = AS_STRING(args[1]);
   if(needle->length < 1 || needle->length > haystack->length) {
     return BOOL_VAL(false);
   }
 
-  int16_t starting_index = 0;
+  int64_t starting_index = 0;
   if(arg_count == 3) {
     starting_index = st_normalize_index(haystack, AS_NUMBER(args[2]));
   }
@@ -250,10 +377,6 @@ Value cc_function_string_index_of(int arg_count, Value* args) {
  * string_contains(haystack_string, needle_string)
  */
 Value cc_function_string_contains(int arg_count, Value* args) {
-  if(arg_count != 2) { return FERROR_VAL(FE_ARG_COUNT_2); }
-  if(!IS_STRING(args[0])) { return FERROR_VAL(FE_ARG_1_STRING); }
-  if(!IS_STRING(args[1])) { return FERROR_VAL(FE_ARG_2_STRING); }
-
   ObjString* haystack = AS_STRING(args[0]);
   ObjString* needle = AS_STRING(args[1]);
   if(needle->length < 1 || needle->length > haystack->length) {
@@ -268,10 +391,6 @@ Value cc_function_string_contains(int arg_count, Value* args) {
  * string_starts_with(haystack_string, needle_string)
  */
 Value cc_function_string_starts_with(int arg_count, Value* args) {
-  if(arg_count != 2) { return FERROR_VAL(FE_ARG_COUNT_2); }
-  if(!IS_STRING(args[0])) { return FERROR_VAL(FE_ARG_1_STRING); }
-  if(!IS_STRING(args[1])) { return FERROR_VAL(FE_ARG_2_STRING); }
-
   ObjString* haystack = AS_STRING(args[0]);
   ObjString* needle = AS_STRING(args[1]);
   if(needle->length < 1 || needle->length > haystack->length) {
@@ -285,25 +404,20 @@ Value cc_function_string_starts_with(int arg_count, Value* args) {
 
 /**
  * string_right_index_of(haystack_string, needle_string, starting_index?)
- * - returns nil on parameter error
+ * - raises an error if the arguments are the wrong number or type
  * - returns false if the given index out of legal range
  * - returns the index at which the substring needle_string is found in the
  *   given haystack_string, optionally starting the search at the given index.
  *   Returns false if the substring could not be located.
  */
 Value cc_function_string_right_index_of(int arg_count, Value* args) {
-  if(arg_count < 2 || arg_count > 3) { return FERROR_VAL(FE_ARG_COUNT_2_3); }
-  if(!IS_STRING(args[0])) { return FERROR_VAL(FE_ARG_1_STRING); }
-  if(!IS_STRING(args[1])) { return FERROR_VAL(FE_ARG_2_STRING); }
-  if(arg_count == 3 && !IS_NUMBER(args[2])) { return FERROR_VAL(FE_ARG_3_NUMBER); }
-
   ObjString* haystack = AS_STRING(args[0]);
   ObjString* needle = AS_STRING(args[1]);
   if(needle->length < 1 || needle->length > haystack->length) {
     return BOOL_VAL(false);
   }
 
-  int16_t starting_index = 0;
+  int64_t starting_index = 0;
   if(arg_count == 3) {
     starting_index = st_normalize_index(haystack, AS_NUMBER(args[2]));
   }
@@ -311,22 +425,14 @@ Value cc_function_string_right_index_of(int arg_count, Value* args) {
     return BOOL_VAL(false);
   }
 
-  bool found = false;
-  Value last_index;
-  while(true) {
-    Value res = str_indexof_core(haystack, needle, starting_index);
-    if(IS_NUMBER(res)) {
-      found = true;
-      last_index = res;
-      starting_index = 1 + (int16_t)AS_NUMBER(last_index);
-    } else if(IS_BOOL(res)) {
-      break;
-    }
-  }
-  if(!found) {
+  int64_t found = st_find_last(
+    haystack->chars + starting_index, haystack->length - starting_index,
+    needle->chars, needle->length
+  );
+  if(found < 0) {
     return BOOL_VAL(false);
   }
-  return last_index;
+  return NUMBER_VAL(starting_index + found);
 }
 
 
@@ -334,62 +440,145 @@ Value cc_function_string_right_index_of(int arg_count, Value* args) {
  * string_ends_with(haystack_string, needle_string)
  */
 Value cc_function_string_ends_with(int arg_count, Value* args) {
-  if(arg_count != 2) { return FERROR_VAL(FE_ARG_COUNT_2); }
-  if(!IS_STRING(args[0])) { return FERROR_VAL(FE_ARG_1_STRING); }
-  if(!IS_STRING(args[1])) { return FERROR_VAL(FE_ARG_2_STRING); }
-
   ObjString* haystack = AS_STRING(args[0]);
   ObjString* needle = AS_STRING(args[1]);
   if(needle->length < 1 || needle->length > haystack->length) {
     return BOOL_VAL(false);
   }
 
-  int16_t expected_index = haystack->length - needle->length;
+  int64_t expected_index = haystack->length - needle->length;
   Value res = str_indexof_core(haystack, needle, expected_index);
   return BOOL_VAL( IS_NUMBER(res) && AS_NUMBER(res) == expected_index );
 }
 
 
+/*
+    Compiled regexes are kept in a small LRU cache keyed by the pattern.  Long
+    patterns and patterns read from files aren't interned, so the same pattern
+    can arrive as different ObjStrings.  Entries are matched by pointer first,
+    then by length, hash and contents.  Everything is compiled as a POSIX
+    extended regex with its captures, so one compiled regex serves every regex
+    native.
+*/
+#define ST_REGEX_CACHE_SIZE 16
+// Room for regerror()'s description of a pattern that didn't compile.
+#define ST_REGEX_ERROR_SIZE 256
+
+typedef struct {
+  ObjString* pattern;
+  regex_t regex;
+  uint64_t last_used;
+} ST_Regex_Entry;
+
+static ST_Regex_Entry st_regex_cache[ST_REGEX_CACHE_SIZE];
+static uint64_t st_regex_clock = 0;
+
+
+static bool st_regex_same_pattern(ObjString* cached, ObjString* pattern) {
+  if(cached == pattern) {
+    return true;
+  }
+  return cached != NULL && cached->length == pattern->length && cached->hash == pattern->hash &&
+         memcmp(cached->chars, pattern->chars, pattern->length) == 0;
+}
+
+
+// Returns NULL if the pattern doesn't compile, with regcomp()'s error code in
+// *code and regerror()'s description of it in error.
+static regex_t* st_regex_compile(ObjString* pattern, int* code, char error[ST_REGEX_ERROR_SIZE]) {
+  ST_Regex_Entry* victim = &st_regex_cache[0];
+  for(int i = 0; i < ST_REGEX_CACHE_SIZE; i++) {
+    ST_Regex_Entry* entry = &st_regex_cache[i];
+    if(st_regex_same_pattern(entry->pattern, pattern)) {
+      entry->last_used = ++st_regex_clock;
+      return &entry->regex;
+    }
+    if(entry->last_used < victim->last_used) {
+      victim = entry;
+    }
+  }
+
+  if(victim->pattern != NULL) {
+    regfree(&victim->regex);
+    victim->pattern = NULL;
+    victim->last_used = 0;
+  }
+  *code = regcomp(&victim->regex, pattern->chars, REG_EXTENDED);
+  if(*code != 0) {
+    regerror(*code, &victim->regex, error, ST_REGEX_ERROR_SIZE);
+    return NULL;
+  }
+  victim->pattern = pattern;
+  victim->last_used = ++st_regex_clock;
+  return &victim->regex;
+}
+
+
+// The whole match followed by each capture group, as strings.  Groups that
+// didn't take part in the match are nil.
+static Value st_regex_captures(const char* subject, regmatch_t* matches, size_t count) {
+  ObjUserArray* captures = newUserArray();
+  ua_grow(captures, count);
+  for(size_t i = 0; i < count; i++) {
+    if(matches[i].rm_so < 0) {
+      captures->inner.values[captures->inner.count++] = NIL_VAL;
+      continue;
+    }
+    captures->inner.values[captures->inner.count++] = OBJ_VAL(copyString(
+      subject + matches[i].rm_so, matches[i].rm_eo - matches[i].rm_so
+    ));
+  }
+  return OBJ_VAL(captures);
+}
+
+
+// Finds the next match at or after offset.  Past the start of the subject,
+// ^ no longer matches.
+static bool st_regex_next(
+  regex_t* regex, ObjString* subject, int64_t offset, regmatch_t* matches, size_t count
+) {
+  if(regexec(regex, subject->chars + offset, count, matches, offset > 0 ? REG_NOTBOL : 0) != 0) {
+    return false;
+  }
+  for(size_t i = 0; i < count; i++) {
+    if(matches[i].rm_so >= 0) {
+      matches[i].rm_so += offset;
+      matches[i].rm_eo += offset;
+    }
+  }
+  return true;
+}
+
+
+// Where to look for the match after this one.  An empty match has to move
+// on by a character, or it would be found again forever.
+static int64_t st_regex_resume(regmatch_t* match) {
+  return match->rm_eo > match->rm_so ? match->rm_eo : match->rm_eo + 1;
+}
+
+
 /**
  * string_regex_matches(string, regex_string)
- * - returns nil on parameter error
+ * - raises an error if the arguments are the wrong number or type
  * - returns nil on regex compile error, lol good luck
  * - returns true if the given extended POSIX regex matches the given string
  */
 Value cc_function_string_regex_matches(int arg_count, Value* args) {
-  if(arg_count != 2 ) { return FERROR_VAL(FE_ARG_COUNT_2); }
-  if(!IS_STRING(args[0])) { return FERROR_VAL(FE_ARG_1_STRING); }
-  if(!IS_STRING(args[1])) { return FERROR_VAL(FE_ARG_2_STRING); }
-
-  regex_t regex_handle;
-  int compile_success = regcomp(
-    &regex_handle,
-    AS_CSTRING(args[1]),
-    REG_EXTENDED | REG_NOSUB // Use POSIX extended regexes, and don't capture
-  );
-  if(compile_success != 0) {
-    int error_buffer_size = regerror(compile_success, &regex_handle, NULL, 0);
-    char* error_buffer = ALLOCATE(char, error_buffer_size + 1);
-    regerror(compile_success, &regex_handle, error_buffer, error_buffer_size);
-    error_buffer[error_buffer_size] = '\0';
-    fprintf(
-      stderr,
-      "string_regex_matches(): regex compile error code %d: \"%s\"\n",
-      compile_success,
-      error_buffer
-    );
-    FREE_ARRAY(char, error_buffer, error_buffer_size + 1);
+  int code;
+  char error[ST_REGEX_ERROR_SIZE];
+  regex_t* regex = st_regex_compile(AS_STRING(args[1]), &code, error);
+  if(regex == NULL) {
+    fprintf(stderr, "string_regex_matches(): regex compile error code %d: \"%s\"\n", code, error);
     return NIL_VAL;
   }
 
   int matched = regexec(
-    &regex_handle,
+    regex,
     AS_CSTRING(args[0]),
-    0,    // Expected number of matches, ignored per REG_NOSUB
-    NULL, // Structure to contain matches, ignored per REG_NOSUB
+    0,    // Expected number of matches, we don't want the captures
+    NULL, // Structure to contain matches
     0     // Flags, of which we care about none.
   );
-  regfree(&regex_handle);
 
   // This'll be zero on success, and non-zero on failure or error.  We don't care
   // about errors right now (@FIXME), so matched / didn't match is good enough.
@@ -397,6 +586,164 @@ Value cc_function_string_regex_matches(int arg_count, Value* args) {
 }
 
 
+/**
+ * string_regex_match(string, regex_string)
+ * - raises an error if the arguments are the wrong number or type
+ * - raises an error if the regex does not compile
+ * - returns false if the regex does not match the string
+ * - returns an array of the whole first match followed by each capture group,
+ *   with nil for groups that did not take part in the match
+ */
+Value cc_function_string_regex_match(int arg_count, Value* args) {
+  ObjString* subject = AS_STRING(args[0]);
+  int code;
+  char error[ST_REGEX_ERROR_SIZE];
+  regex_t* regex = st_regex_compile(AS_STRING(args[1]), &code, error);
+  if(regex == NULL) {
+    return FERROR_DETAIL_VAL(FE_REGEX_COMPILE_FAILED, error);
+  }
+
+  size_t count = regex->re_nsub + 1;
+  regmatch_t* matches = ALLOCATE(regmatch_t, count);
+  Value result = BOOL_VAL(false);
+  if(st_regex_next(regex, subject, 0, matches, count)) {
+    result = st_regex_captures(subject->chars, matches, count);
+  }
+  FREE_ARRAY(regmatch_t, matches, count);
+  return result;
+}
+
+
+/**
+ * string_regex_find_all(string, regex_string)
+ * - raises an error if the arguments are the wrong number or type
+ * - raises an error if the regex does not compile
+ * - returns an array with one element per non-overlapping match, left to
+ *   right, each an array laid out like string_regex_match() returns
+ */
+Value cc_function_string_regex_find_all(int arg_count, Value* args) {
+  ObjString* subject = AS_STRING(args[0]);
+  int code;
+  char error[ST_REGEX_ERROR_SIZE];
+  regex_t* regex = st_regex_compile(AS_STRING(args[1]), &code, error);
+  if(regex == NULL) {
+    return FERROR_DETAIL_VAL(FE_REGEX_COMPILE_FAILED, error);
+  }
+
+  size_t count = regex->re_nsub + 1;
+  regmatch_t* matches = ALLOCATE(regmatch_t, count);
+  ObjUserArray* found = newUserArray();
+  int64_t offset = 0;
+  while(offset <= subject->length && st_regex_next(regex, subject, offset, matches, count)) {
+    ua_grow(found, found->inner.count + 1);
+    found->inner.values[found->inner.count++] = st_regex_captures(subject->chars, matches, count);
+    offset = st_regex_resume(&matches[0]);
+  }
+  FREE_ARRAY(regmatch_t, matches, count);
+  return OBJ_VAL(found);
+}
+
+
+typedef struct {
+  char* chars;
+  int64_t length;
+  int64_t capacity;
+} ST_Buffer;
+
+static void st_buffer_append(ST_Buffer* buffer, const char* chars, int64_t length) {
+  if(buffer->length + length + 1 > buffer->capacity) {
+    int64_t old_capacity = buffer->capacity;
+    while(buffer->length + length + 1 > buffer->capacity) {
+      buffer->capacity = GROW_CAPACITY(buffer->capacity);
+    }
+    buffer->chars = GROW_ARRAY(buffer->chars, char, old_capacity, buffer->capacity);
+  }
+  memcpy(buffer->chars + buffer->length, chars, length);
+  buffer->length += length;
+}
+
+
+// Appends the replacement for one match.  \0 through \9 in the replacement
+// stand for the whole match and its capture groups, and \\ for a backslash.
+static void st_regex_append_replacement(
+  ST_Buffer* buffer, ObjString* subject, ObjString* replacement,
+  regmatch_t* matches, size_t count
+) {
+  const char* chars = replacement->chars;
+  int64_t literal_start = 0;
+  for(int64_t i = 0; i + 1 < replacement->length; i++) {
+    if(chars[i] != '\\') {
+      continue;
+    }
+    char next = chars[i + 1];
+    if(next != '\\' && (next < '0' || next > '9')) {
+      continue;
+    }
+    st_buffer_append(buffer, chars + literal_start, i - literal_start);
+    if(next == '\\') {
+      st_buffer_append(buffer, "\\", 1);
+    } else {
+      size_t group = next - '0';
+      if(group < count && matches[group].rm_so >= 0) {
+        st_buffer_append(
+          buffer, subject->chars + matches[group].rm_so,
+          matches[group].rm_eo - matches[group].rm_so
+        );
+      }
+    }
+    i++;
+    literal_start = i + 1;
+  }
+  st_buffer_append(buffer, chars + literal_start, replacement->length - literal_start);
+}
+
+
+/**
+ * string_regex_replace(string, regex_string, replacement_string, limit?)
+ * - raises an error if the arguments are the wrong number or type
+ * - raises an error if the regex does not compile
+ * - returns a copy of the string with every match of the regex, or only the
+ *   first limit of them, swapped for the replacement.  \0 through \9 in the
+ *   replacement insert the whole match or one of its capture groups, and \\
+ *   inserts a backslash.
+ */
+Value cc_function_string_regex_replace(int arg_count, Value* args) {
+  ObjString* subject = AS_STRING(args[0]);
+  ObjString* replacement = AS_STRING(args[2]);
+  double limit = arg_count == 4 ? trunc(AS_NUMBER(args[3])) : INFINITY;
+  int code;
+  char error[ST_REGEX_ERROR_SIZE];
+  regex_t* regex = st_regex_compile(AS_STRING(args[1]), &code, error);
+  if(regex == NULL) {
+    return FERROR_DETAIL_VAL(FE_REGEX_COMPILE_FAILED, error);
+  }
+
+  size_t count = regex->re_nsub + 1;
+  regmatch_t* matches = ALLOCATE(regmatch_t, count);
+  ST_Buffer buffer = { NULL, 0, 0 };
+  int64_t copied = 0;
+  int64_t offset = 0;
+  double replaced = 0;
+  while(replaced < limit && offset <= subject->length &&
+        st_regex_next(regex, subject, offset, matches, count)) {
+    st_buffer_append(&buffer, subject->chars + copied, matches[0].rm_so - copied);
+    st_regex_append_replacement(&buffer, subject, replacement, matches, count);
+    copied = matches[0].rm_eo;
+    offset = st_regex_resume(&matches[0]);
+    replaced++;
+  }
+  FREE_ARRAY(regmatch_t, matches, count);
+
+  if(replaced == 0) {
+    return args[0];
+  }
+  st_buffer_append(&buffer, subject->chars + copied, subject->length - copied);
+  ObjString* result = copyString(buffer.chars, buffer.length);
+  FREE_ARRAY(char, buffer.chars, buffer.capacity);
+  return OBJ_VAL(result);
+}
+
+
 /**
  * string_replace(haystack_string, needle_string, replace_string)
  */
@@ -431,26 +778,21 @@ Value cc_function_string_shuffle(int arg_count, Value* args) { return NIL_VAL; }
  * string_pad_left(source_string, padding_string, minimum_width)
  */
 Value cc_function_string_pad_left(int arg_count, Value* args) {
-  if (arg_count != 3) { return FERROR_VAL(FE_ARG_COUNT_3); }
-  if (!IS_STRING(args[0])) { return FERROR_VAL(FE_ARG_1_STRING); }
-  if (!IS_STRING(args[1])) { return FERROR_VAL(FE_ARG_2_STRING); }
-  if (!IS_NUMBER(args[2])) { return FERROR_VAL(FE_ARG_3_NUMBER); }
-
   ObjString* source = AS_STRING(args[0]);
   ObjString* padding = AS_STRING(args[1]);
-  int minimum_width = AS_NUMBER(args[2]);
+  int64_t minimum_width = AS_NUMBER(args[2]);
 
   if (source->length >= minimum_width) { return args[0]; }
 
   char* new_string = ALLOCATE(char, minimum_width + 1);
   memset(new_string, ' ', minimum_width);
 
-  int chars_to_pad = minimum_width - source->length;
-  int padding_repeat_count = ceil((double)chars_to_pad / (double)padding->length);
+  int64_t chars_to_pad = minimum_width - source->length;
+  int64_t padding_repeat_count = ceil((double)chars_to_pad / (double)padding->length);
 
-  for (int i = 0; i < padding_repeat_count; i++) {
-    int copy_length = padding->length;
-    int target = i * padding->length;
+  for (int64_t i = 0; i < padding_repeat_count; i++) {
+    int64_t copy_length = padding->length;
+    int64_t target = i * padding->length;
     while (target + copy_length > minimum_width) {
       copy_length--;
     }
@@ -468,14 +810,9 @@ Value cc_function_string_pad_left(int arg_count, Value* args) {
  * string_pad_right(source_string, padding_string, minimum_width)
  */
 Value cc_function_string_pad_right(int arg_count, Value* args) {
-  if (arg_count != 3) { return FERROR_VAL(FE_ARG_COUNT_3); }
-  if (!IS_STRING(args[0])) { return FERROR_VAL(FE_ARG_1_STRING); }
-  if (!IS_STRING(args[1])) { return FERROR_VAL(FE_ARG_2_STRING); }
-  if (!IS_NUMBER(args[2])) { return FERROR_VAL(FE_ARG_3_NUMBER); }
-
   ObjString* source = AS_STRING(args[0]);
   ObjString* padding = AS_STRING(args[1]);
-  int minimum_width = AS_NUMBER(args[2]);
+  int64_t minimum_width = AS_NUMBER(args[2]);
 
   if (source->length >= minimum_width) { return args[0]; }
 
@@ -483,12 +820,12 @@ Value cc_function_string_pad_right(int arg_count, Value* args) {
   memset(new_string, ' ', minimum_width);
   memcpy(new_string, source->chars, source->length);
 
-  int chars_to_pad = minimum_width - source->length;
-  int padding_repeat_count = ceil((double)chars_to_pad / (double)padding->length);
+  int64_t chars_to_pad = minimum_width - source->length;
+  int64_t padding_repeat_count = ceil((double)chars_to_pad / (double)padding->length);
 
-  for (int i = 0; i < padding_repeat_count; i++) {
-    int copy_length = padding->length;
-    int target = source->length + (i * padding->length);
+  for (int64_t i = 0; i < padding_repeat_count; i++) {
+    int64_t copy_length = padding->length;
+    int64_t target = source->length + (i * padding->length);
     while (target + copy_length > minimum_width) {
       copy_length--;
     }
@@ -505,43 +842,38 @@ Value cc_function_string_pad_right(int arg_count, Value* args) {
  * string_center(source_string, padding_string, minimum_width)
  */
 Value cc_function_string_center(int arg_count, Value* args) {
-  if (arg_count != 3) { return FERROR_VAL(FE_ARG_COUNT_3); }
-  if (!IS_STRING(args[0])) { return FERROR_VAL(FE_ARG_1_STRING); }
-  if (!IS_STRING(args[1])) { return FERROR_VAL(FE_ARG_2_STRING); }
-  if (!IS_NUMBER(args[2])) { return FERROR_VAL(FE_ARG_3_NUMBER); }
-
   ObjString* source = AS_STRING(args[0]);
   ObjString* padding = AS_STRING(args[1]);
-  int minimum_width = AS_NUMBER(args[2]);
+  int64_t minimum_width = AS_NUMBER(args[2]);
 
   if (source->length >= minimum_width) { return args[0]; }
 
   char* new_string = ALLOCATE(char, minimum_width + 1);
   memset(new_string, ' ', minimum_width);
 
-  int chars_to_pad = minimum_width - source->length;
-  int left_chars_to_pad = 0;
-  int right_chars_to_pad = 0;
+  int64_t chars_to_pad = minimum_width - source->length;
+  int64_t left_chars_to_pad = 0;
+  int64_t right_chars_to_pad = 0;
   // Padding grows to the right before it grows to the left.
   while (chars_to_pad > 0) {
     if (chars_to_pad-- > 0) { right_chars_to_pad++; }
     if (chars_to_pad-- > 0) { left_chars_to_pad++;  }
   }
-  int left_padding_repeat_count = ceil((double)left_chars_to_pad / (double)padding->length);
-  int right_padding_repeat_count = ceil((double)right_chars_to_pad / (double)padding->length);
+  int64_t left_padding_repeat_count = ceil((double)left_chars_to_pad / (double)padding->length);
+  int64_t right_padding_repeat_count = ceil((double)right_chars_to_pad / (double)padding->length);
 
-  for (int i = 0; i < left_padding_repeat_count; i++) {
-    int copy_length = padding->length;
-    int target = i * padding->length;
+  for (int64_t i = 0; i < left_padding_repeat_count; i++) {
+    int64_t copy_length = padding->length;
+    int64_t target = i * padding->length;
     while (target + copy_length > left_chars_to_pad) {
       copy_length--;
     }
     memcpy(&new_string[target], padding->chars, copy_length);
   }
 
-  for (int i = 0; i < right_padding_repeat_count; i++) {
-    int copy_length = padding->length;
-    int target = left_chars_to_pad + source->length + (i * padding->length);
+  for (int64_t i = 0; i < right_padding_repeat_count; i++) {
+    int64_t copy_length = padding->length;
+    int64_t target = left_chars_to_pad + source->length + (i * padding->length);
     while (target + copy_length > minimum_width) {
       copy_length--;
     }
@@ -572,10 +904,6 @@ static char default_whitespace[] = { ' ', '\r', '\n', '\t', '\0' };
  * string_trim(source_string, chars_to_replace = whitespace)
  */
 Value cc_function_string_trim(int arg_count, Value* args) {
-  if (arg_count < 1 || arg_count > 2) { return FERROR_VAL(FE_ARG_COUNT_1_2); }
-  if (!IS_STRING(args[0])) { return FERROR_VAL(FE_ARG_1_STRING); }
-  if (arg_count == 2 && !IS_STRING(args[1])) { return FERROR_VAL(FE_ARG_2_STRING); }
-
   ObjString* str = AS_STRING(args[0]);
 
   char* whitespace = default_whitespace;
@@ -584,8 +912,8 @@ Value cc_function_string_trim(int arg_count, Value* args) {
   }
 
   bool found_whitespace = true;
-  int left_trimlen = 0;
-  int right_trimlen = 0;
+  int64_t left_trimlen = 0;
+  int64_t right_trimlen = 0;
 
   while (found_whitespace) {
     found_whitespace = false;
@@ -620,10 +948,6 @@ Value cc_function_string_trim(int arg_count, Value* args) {
  * string_trim_left(source_string, chars_to_replace = whitespace)
  */
 Value cc_function_string_trim_left(int arg_count, Value* args) {
-  if (arg_count < 1 || arg_count > 2) { return FERROR_VAL(FE_ARG_COUNT_1_2); }
-  if (!IS_STRING(args[0])) { return FERROR_VAL(FE_ARG_1_STRING); }
-  if (arg_count == 2 && !IS_STRING(args[1])) { return FERROR_VAL(FE_ARG_2_STRING); }
-
   ObjString* str = AS_STRING(args[0]);
 
   char* whitespace = default_whitespace;
@@ -632,7 +956,7 @@ Value cc_function_string_trim_left(int arg_count, Value* args) {
   }
 
   bool found_whitespace = true;
-  int trimlen = 0;
+  int64_t trimlen = 0;
   while (found_whitespace) {
     found_whitespace = false;
     for (int i = 0; whitespace[i] != '\0'; i++) {
@@ -654,10 +978,6 @@ Value cc_function_string_trim_left(int arg_count, Value* args) {
  * string_trim_right(source_string, chars_to_replace = whitespace)
  */
 Value cc_function_string_trim_right(int arg_count, Value* args) {
-  if (arg_count < 1 || arg_count > 2) { return FERROR_VAL(FE_ARG_COUNT_1_2); }
-  if (!IS_STRING(args[0])) { return FERROR_VAL(FE_ARG_1_STRING); }
-  if (arg_count == 2 && !IS_STRING(args[1])) { return FERROR_VAL(FE_ARG_2_STRING); }
-
   ObjString* str = AS_STRING(args[0]);
 
   char* whitespace = default_whitespace;
@@ -666,7 +986,7 @@ Value cc_function_string_trim_right(int arg_count, Value* args) {
   }
 
   bool found_whitespace = true;
-  int trimlen = 0;
+  int64_t trimlen = 0;
   while (found_whitespace) {
     found_whitespace = false;
     for (int i = 0; whitespace[i] != '\0'; i++) {
@@ -703,35 +1023,38 @@ Value cc_function_char_from_integer(int arg_count, Value* args) { return NIL_VAL
 
 
 void cc_register_ext_string() {
-  defineNative("string_length",         cc_function_string_length);
+  defineNativeSignature("string_length", cc_function_string_length, 1, 1, "s");
 
-  defineNative("string_substring",      cc_function_string_substring);
-  defineNative("string_split",          cc_function_string_split);
+  defineNativeSignature("string_substring", cc_function_string_substring, 2, 3, "snn");
+  defineNativeSignature("string_split",     cc_function_string_split,     2, 3, "ssn");
 
-  defineNative("string_index_of",       cc_function_string_index_of);
-  defineNative("string_contains",       cc_function_string_contains);
-  defineNative("string_starts_with",    cc_function_string_starts_with);
-  defineNative("string_right_index_of", cc_function_string_right_index_of);
-  defineNative("string_ends_with",      cc_function_string_ends_with);
+  defineNativeSignature("string_index_of",       cc_function_string_index_of,       2, 3, "ssn");
+  defineNativeSignature("string_contains",       cc_function_string_contains,       2, 2, "ss");
+  defineNativeSignature("string_starts_with",    cc_function_string_starts_with,    2, 2, "ss");
+  defineNativeSignature("string_right_index_of", cc_function_string_right_index_of, 2, 3, "ssn");
+  defineNativeSignature("string_ends_with",      cc_function_string_ends_with,      2, 2, "ss");
 
-  defineNative("string_regex_matches",  cc_function_string_regex_matches);
+  defineNativeSignature("string_regex_matches",  cc_function_string_regex_matches,  2, 2, "ss");
+  defineNativeSignature("string_regex_match",    cc_function_string_regex_match,    2, 2, "ss");
+  defineNativeSignature("string_regex_find_all", cc_function_string_regex_find_all, 2, 2, "ss");
+  defineNativeSignature("string_regex_replace",  cc_function_string_regex_replace,  3, 4, "sssn");
 
   defineNative("string_replace",        cc_function_string_replace);
   defineNative("string_splice",         cc_function_string_splice);
 
   defineNative("string_repeat",         cc_function_string_repeat);
 
-  defineNative("string_reverse",        cc_function_string_reverse);
-  defineNative("string_shuffle",        cc_function_string_shuffle);
-  defineNative("string_pad_left",       cc_function_string_pad_left);
-  defineNative("string_pad_right",      cc_function_string_pad_right);
-  defineNative("string_center",         cc_function_string_center);
-  defineNative("string_escape_dq",      cc_function_string_escape_dq);
-  defineNative("string_chunk",          cc_function_string_chunk);
-
-  defineNative("string_trim",           cc_function_string_trim);
-  defineNative("string_trim_left",      cc_function_string_trim_left);
-  defineNative("string_trim_right",     cc_function_string_trim_right);
+  defineNative("string_reverse",            cc_function_string_reverse);
+  defineNative("string_shuffle",            cc_function_string_shuffle);
+  defineNativeSignature("string_pad_left",  cc_function_string_pad_left,  3, 3, "ssn");
+  defineNativeSignature("string_pad_right", cc_function_string_pad_right, 3, 3, "ssn");
+  defineNativeSignature("string_center",    cc_function_string_center,    3, 3, "ssn");
+  defineNative("string_escape_dq",          cc_function_string_escape_dq);
+  defineNative("string_chunk",              cc_function_string_chunk);
+
+  defineNativeSignature("string_trim",       cc_function_string_trim,       1, 2, "ss");
+  defineNativeSignature("string_trim_left",  cc_function_string_trim_left,  1, 2, "ss");
+  defineNativeSignature("string_trim_right", cc_function_string_trim_right, 1, 2, "ss");
 
   defineNative("stringify",             cc_function_stringify);
   defineNative("char_to_integer",       cc_function_char_to_integer);
@@ -1,6 +1,14 @@
 #ifndef cc_ext_string_h
 #define cc_ext_string_h
 
+#include "../value.h"
+
+Value cc_function_string_split(int arg_count, Value* args);
+Value cc_function_string_index_of(int arg_count, Value* args);
+Value cc_function_string_trim(int arg_count, Value* args);
+int64_t st_find(
+  const char* haystack, int64_t haystack_length, const char* needle, int64_t needle_length
+);
 void cc_register_ext_string();
 
 #endif
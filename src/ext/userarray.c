@@ -6,13 +6,38 @@
 #include "../object.h"
 #include "../value.h"
 #include "../vm.h"
+#include "../workers.h"
 
 #include "number.h"
 #include "ferrors.h"
 
 
-void ua_grow(ObjUserArray* ua, int new_capacity) {
-    int old_capacity = ua->inner.capacity;
+// Moves the elements back to the start of the allocation, handing the free
+// slots in front over to the end.  Every slot past the last element is nil.
+static void ua_slide_to_start(ObjUserArray* ua) {
+    Value* start = ua->inner.values - ua->front;
+    memmove(start, ua->inner.values, ua->inner.count * sizeof(Value));
+    int64_t stale = ua->front < ua->inner.count ? ua->front : ua->inner.count;
+    for(int64_t i = 0; i < stale; i++) {
+        start[ua->inner.count + ua->front - stale + i] = NIL_VAL;
+    }
+    ua->inner.values = start;
+    ua->inner.capacity += ua->front;
+    ua->front = 0;
+}
+
+void ua_grow(ObjUserArray* ua, int64_t new_capacity) {
+    if(ua->inner.capacity > new_capacity) {
+        return;
+    }
+    // An array used as a queue ends up with its free space in front.  Once
+    // there's at least as much of it as there are elements, sliding them back
+    // costs no more than the ar_shift() calls that made the room.
+    if(ua->front > 0 && ua->front >= ua->inner.count) {
+        ua_slide_to_start(ua);
+    }
+
+    int64_t old_capacity = ua->inner.capacity;
     while(ua->inner.capacity <= new_capacity) {
         ua->inner.capacity = GROW_CAPACITY(ua->inner.capacity);
     }
@@ -21,42 +46,103 @@ void ua_grow(ObjUserArray* ua, int new_capacity) {
         return;
     }
 
-    ua->inner.values = GROW_ARRAY(ua->inner.values, Value, old_capacity, ua->inner.capacity);
+    Value* start = GROW_ARRAY(
+        ua->inner.values - ua->front, Value,
+        ua->front + old_capacity, ua->front + ua->inner.capacity
+    );
+    ua->inner.values = start + ua->front;
     // Initialize each newly allocated Value element as nil.
     for(; old_capacity < ua->inner.capacity; old_capacity++) {
         ua->inner.values[old_capacity] = NIL_VAL;
     }
 }
 
-static int16_t ua_normalize_index(ObjUserArray* ua, double target_index, bool valid_indexes_only) {
-    int64_t index = (int64_t)floor(target_index);
+
+// Makes sure there's a free slot in front of the first element.  The room in
+// front doubles each time it runs out, so ar_unshift() is amortized O(1).
+static void ua_reserve_front(ObjUserArray* ua) {
+    if(ua->front > 0) {
+        return;
+    }
+    int64_t front = ua->inner.count < 8 ? 8 : ua->inner.count;
+    Value* start = ALLOCATE(Value, front + ua->inner.capacity);
+    for(int64_t i = 0; i < front; i++) {
+        start[i] = NIL_VAL;
+    }
+    if(ua->inner.capacity > 0) {
+        memcpy(start + front, ua->inner.values, ua->inner.capacity * sizeof(Value));
+    }
+    FREE_ARRAY(Value, ua->inner.values, ua->inner.capacity);
+    ua->inner.values = start + front;
+    ua->front = front;
+}
+
+
+// Drops the first count elements by moving the start of the array past them.
+static void ua_drop_front(ObjUserArray* ua, int64_t count) {
+    for(int64_t i = 0; i < count; i++) {
+        ua->inner.values[i] = NIL_VAL;
+    }
+    ua->inner.values += count;
+    ua->inner.capacity -= count;
+    ua->inner.count -= count;
+    ua->front += count;
+    if(ua->inner.count == 0) {
+        // Nothing to move, so an emptied queue starts over for free.
+        ua_slide_to_start(ua);
+    }
+}
+
+// Appends count values, which the caller has already made room for.
+static void ua_copy_values(ObjUserArray* ua, Value* values, int64_t count) {
+    if(count > 0) {
+        memcpy(&ua->inner.values[ua->inner.count], values, count * sizeof(Value));
+        ua->inner.count += count;
+    }
+}
+
+// The largest index an array can grow to.  Past this, the bytes for its
+// values would no longer fit in a size_t.
+#define UA_MAX_INDEX ((int64_t)(SIZE_MAX / sizeof(Value) / 2))
+
+static int64_t ua_normalize_index(ObjUserArray* ua, double target_index, bool valid_indexes_only) {
+    // Doubles out of int64_t range can't be converted, so they're rejected
+    // before any conversion happens.
+    double floored_index = floor(target_index);
+    if(!(floored_index >= -(double)UA_MAX_INDEX && floored_index <= (double)UA_MAX_INDEX)) {
+        return -1;
+    }
+    int64_t index = (int64_t)floored_index;
     if(index < 0) {
         index += ua->inner.count;
     }
 
-    if(index > INT16_MAX || index < 0 || (valid_indexes_only && index >= ua->inner.count)) {
+    if(index > UA_MAX_INDEX || index < 0 || (valid_indexes_only && index >= ua->inner.count)) {
         return -1;
     }
-    return (int16_t)index;
+    return index;
 }
 
-static int16_t ua_normalize_range(ObjUserArray* ua, uint16_t target_index, double target_range) {
-    int64_t range = (int64_t)floor(target_range);
-    if (range + target_index < 0) {
+static int64_t ua_normalize_range(ObjUserArray* ua, int64_t target_index, double target_range) {
+    double floored_range = floor(target_range);
+    if(isnan(floored_range)) {
+        floored_range = 0;
+    }
+    if (floored_range + target_index < 0) {
         // Only allow negative ranges to reach the first element in the array.
         // That is, ranges can't go negative and loop around like an index.
-        range = target_index * -1;
+        return target_index * -1;
     }
-    if(range + target_index >= ua->inner.count) {
+    if(floored_range + target_index >= ua->inner.count) {
         // Clamp positive ranges to the end of the array.
-        range = ua->inner.count - target_index;
+        return ua->inner.count - target_index;
     }
-    return (int16_t)range;
+    return (int64_t)floored_range;
 }
 
 struct UA_Legal_Range {
-    int16_t index;
-    int16_t range;
+    int64_t index;
+    int64_t range;
     bool error;
 };
 
@@ -87,17 +173,13 @@ Value cc_function_ar_create(int arg_count, Value* args) {
 
 /**
  * ar_set(user_array, key, value)
- * - returns nil on parameter error
+ * - raises an error if the arguments are the wrong number or type
  * - returns false if the given index is negative and out of legal range
  * - returns true on success
  */
 Value cc_function_ar_set(int arg_count, Value* args) {
-    if(arg_count != 3) { return FERROR_VAL(FE_ARG_COUNT_3); }
-    if(!IS_USERARRAY(args[0])) { return FERROR_VAL(FE_ARG_1_ARRAY); }
-    if(!IS_NUMBER(args[1])) { return FERROR_VAL(FE_ARG_2_NUMBER); }
-
     ObjUserArray* ua = AS_USERARRAY(args[0]);
-    int16_t target_index = ua_normalize_index(ua, AS_NUMBER(args[1]), false);
+    int64_t target_index = ua_normalize_index(ua, AS_NUMBER(args[1]), false);
     if(target_index < 0) {
         return BOOL_VAL(false);
     }
@@ -117,17 +199,13 @@ Value cc_function_ar_set(int arg_count, Value* args) {
 
 /**
  * ar_update(user_array, key, value)
- * - returns nil on paramater error
+ * - raises an error if the arguments are the wrong number or type
  * - returns false if the given index is negative and out of legal range
  * - returns the previous value of the given key on success, which may be nil
  */
 Value cc_function_ar_update(int arg_count, Value* args) {
-    if(arg_count != 3) { return FERROR_VAL(FE_ARG_COUNT_3); }
-    if(!IS_USERARRAY(args[0])) { return FERROR_VAL(FE_ARG_1_ARRAY); }
-    if(!IS_NUMBER(args[1])) { return FERROR_VAL(FE_ARG_2_NUMBER); }
-
     ObjUserArray* ua = AS_USERARRAY(args[0]);
-    int16_t target_index = ua_normalize_index(ua, AS_NUMBER(args[1]), false);
+    int64_t target_index = ua_normalize_index(ua, AS_NUMBER(args[1]), false);
     if(target_index < 0) {
         return BOOL_VAL(false);
     }
@@ -147,17 +225,13 @@ Value cc_function_ar_update(int arg_count, Value* args) {
 
 /**
  * ar_has(user_array, key)
- * - returns nil on paramater error
+ * - raises an error if the arguments are the wrong number or type
  * - returns false if the the given index is out of bounds of the array
  * - returns true otherwise
  */
 Value cc_function_ar_has(int arg_count, Value* args) {
-    if(arg_count != 2) { return FERROR_VAL(FE_ARG_COUNT_2); }
-    if(!IS_USERARRAY(args[0])) { return FERROR_VAL(FE_ARG_1_ARRAY); }
-    if(!IS_NUMBER(args[1])) { return FERROR_VAL(FE_ARG_2_NUMBER); }
-
     ObjUserArray* ua = AS_USERARRAY(args[0]);
-    int16_t target_index = ua_normalize_index(ua, AS_NUMBER(args[1]), true);
+    int64_t target_index = ua_normalize_index(ua, AS_NUMBER(args[1]), true);
     if(target_index < 0) {
         return BOOL_VAL(false);
     }
@@ -169,7 +243,7 @@ Value cc_function_ar_has(int arg_count, Value* args) {
 
 /**
  * ar_get(user_array, key)
- * - returns nil on paramater error
+ * - raises an error if the arguments are the wrong number or type
  * - returns nil if the the given index is out of bounds of the array
  *   !! Normally key-checking functions like this would instead return false.
  *      This function returns nil instead of false to remove possible ambiguity
@@ -177,12 +251,8 @@ Value cc_function_ar_has(int arg_count, Value* args) {
  * - returns the value of the given key on success, which may still be nil.
  */
 Value cc_function_ar_get(int arg_count, Value* args) {
-    if(arg_count != 2) { return FERROR_VAL(FE_ARG_COUNT_2); }
-    if(!IS_USERARRAY(args[0])) { return FERROR_VAL(FE_ARG_1_ARRAY); }
-    if(!IS_NUMBER(args[1])) { return FERROR_VAL(FE_ARG_2_NUMBER); }
-
     ObjUserArray* ua = AS_USERARRAY(args[0]);
-    int16_t target_index = ua_normalize_index(ua, AS_NUMBER(args[1]), true);
+    int64_t target_index = ua_normalize_index(ua, AS_NUMBER(args[1]), true);
     if(target_index < 0) {
         return NIL_VAL;
     }
@@ -192,17 +262,12 @@ Value cc_function_ar_get(int arg_count, Value* args) {
 
 /**
  * ar_remove(user_array, key, count? = 1)
- * - returns nil on parameter error
+ * - raises an error if the arguments are the wrong number or type
  * - returns false if the the given index is out of bounds of the array
  * - returns the numeric count of the number of values removed from the array,
  *   after the key and count are normalized to fit within the bounds of the array.
  */
 Value cc_function_ar_remove(int arg_count, Value* args) {
-    if(arg_count < 2 || arg_count > 3) { return FERROR_VAL(FE_ARG_COUNT_2_3); }
-    if(!IS_USERARRAY(args[0])) { return FERROR_VAL(FE_ARG_1_ARRAY); }
-    if(!IS_NUMBER(args[1])) { return FERROR_VAL(FE_ARG_2_NUMBER); }
-    if(arg_count == 3 && !IS_NUMBER(args[2])) { return FERROR_VAL(FE_ARG_3_NUMBER); }
-
     ObjUserArray* ua = AS_USERARRAY(args[0]);
     double raw_range = 1;
     if(arg_count == 3 && IS_NUMBER(args[2])) {
@@ -213,21 +278,33 @@ Value cc_function_ar_remove(int arg_count, Value* args) {
         return BOOL_VAL(false);
     }
 
-    int starting_index = legal.index;
-    int distance = legal.range;
-    int max_index = ua->inner.count - 1 - distance;
+    int64_t starting_index = legal.index;
+    int64_t distance = legal.range;
+    int64_t max_index = ua->inner.count - 1 - distance;
 
     if(distance == 0) {
         return BOOL_VAL(false);
     }
 
-    // We're creating a gap, and then backfilling it with elements from the rest
-    // of the array, only we're actually skipping the gap creation.
-    for(int i = starting_index; i <= max_index; i++) {
-        ua->inner.values[i] = ua->inner.values[i + distance];
-    }
+    // We're creating a gap, and then closing it from whichever side has fewer
+    // elements to move.  Closing it from the front moves the start of the
+    // array instead of its end.
+    if(starting_index < max_index + 1 - starting_index) {
+        memmove(
+            &ua->inner.values[distance],
+            ua->inner.values,
+            starting_index * sizeof(Value)
+        );
+        ua_drop_front(ua, distance);
+        return NUMBER_VAL(distance);
+    }
+    memmove(
+        &ua->inner.values[starting_index],
+        &ua->inner.values[starting_index + distance],
+        (max_index + 1 - starting_index) * sizeof(Value)
+    );
     // We've copied the values over, not moved them.  Clear up the old copies.
-    for(int i = ua->inner.count - 1; i > max_index; i--) {
+    for(int64_t i = ua->inner.count - 1; i > max_index; i--) {
         ua->inner.values[i] = NIL_VAL;
     }
     ua->inner.count -= distance;
@@ -236,44 +313,36 @@ Value cc_function_ar_remove(int arg_count, Value* args) {
 
 /**
  * ar_count(user_array)
- * - returns nil on parameter error
+ * - raises an error if the arguments are the wrong number or type
  * - returns the number of entries in the array, which may be zero
  */
 Value cc_function_ar_count(int arg_count, Value* args) {
-    if(arg_count != 1) { return FERROR_VAL(FE_ARG_COUNT_1); }
-    if(!IS_USERARRAY(args[0])) { return FERROR_VAL(FE_ARG_1_ARRAY); }
-
     return NUMBER_VAL(AS_USERARRAY(args[0])->inner.count);
 }
 
 
 /**
  * ar_clear(user_array)
- * - returns nil on parameter error
+ * - raises an error if the arguments are the wrong number or type
  * - returns true on success
  */
 Value cc_function_ar_clear(int arg_count, Value* args) {
-    if(arg_count != 1) { return FERROR_VAL(FE_ARG_COUNT_1); }
-    if(!IS_USERARRAY(args[0])) { return FERROR_VAL(FE_ARG_1_ARRAY); }
-
     ObjUserArray* ua = AS_USERARRAY(args[0]);
-    freeValueArray(&ua->inner);
+    FREE_ARRAY(Value, ua->inner.values - ua->front, ua->front + ua->inner.capacity);
     initValueArray(&ua->inner);
+    ua->front = 0;
     return BOOL_VAL(true);
 }
 
 
 /**
  * ar_push(user_array, value)
- * - returns nil on parameter error
+ * - raises an error if the arguments are the wrong number or type
  * - returns the new number of elements in the array
  */
 Value cc_function_ar_push(int arg_count, Value* args) {
-    if(arg_count != 2) { return FERROR_VAL(FE_ARG_COUNT_2); }
-    if(!IS_USERARRAY(args[0])) { return FERROR_VAL(FE_ARG_1_ARRAY); }
-
     ObjUserArray* ua = AS_USERARRAY(args[0]);
-    int16_t target_index = ua->inner.count;
+    int64_t target_index = ua->inner.count;
     if(target_index >= ua->inner.capacity) {
         ua_grow(ua, target_index + 1);
     }
@@ -285,24 +354,18 @@ Value cc_function_ar_push(int arg_count, Value* args) {
 
 /**
  * ar_unshift(user_array, value)
- * - returns nil on parameter error
+ * - raises an error if the arguments are the wrong number or type
  * - returns the new number of elements in the array
  */
 Value cc_function_ar_unshift(int arg_count, Value* args) {
-    if(arg_count != 2) { return FERROR_VAL(FE_ARG_COUNT_2); }
-    if(!IS_USERARRAY(args[0])) { return FERROR_VAL(FE_ARG_1_ARRAY); }
-
     ObjUserArray* ua = AS_USERARRAY(args[0]);
-    // We're moving all of the elements up by one, then setting the passed
-    // value as index zero.  Let's make sure we have room to grow.
+    // Rather than moving all of the elements up by one, the start of the
+    // array moves down by one into the free space in front of it.
+    ua_reserve_front(ua);
+    ua->inner.values--;
+    ua->inner.capacity++;
     ua->inner.count++;
-    if(ua->inner.count >= ua->inner.capacity) {
-        ua_grow(ua, ua->inner.count + 1);
-    }
-    for(int i = ua->inner.count; i > 0; i--) {
-        int j = i - 1;
-        ua->inner.values[i] = ua->inner.values[j];
-    }
+    ua->front--;
     ua->inner.values[0] = args[1];
     return NUMBER_VAL(ua->inner.count);
 }
@@ -310,13 +373,10 @@ Value cc_function_ar_unshift(int arg_count, Value* args) {
 
 /**
  * ar_pop(user_array)
- * - returns nil on parameter error
+ * - raises an error if the arguments are the wrong number or type
  * - returns the value of the last element of the array, after it has been removed
  */
 Value cc_function_ar_pop(int arg_count, Value* args) {
-    if(arg_count != 1) { return FERROR_VAL(FE_ARG_COUNT_1); }
-    if(!IS_USERARRAY(args[0])) { return FERROR_VAL(FE_ARG_1_ARRAY); }
-
     ObjUserArray* ua = AS_USERARRAY(args[0]);
 
     if(ua->inner.count == 0) {
@@ -332,13 +392,10 @@ Value cc_function_ar_pop(int arg_count, Value* args) {
 
 /**
  * ar_shift(user_array)
- * - returns nil on parameter error
+ * - raises an error if the arguments are the wrong number or type
  * - returns the value of the first element in the array, after it has been removed
  */
 Value cc_function_ar_shift(int arg_count, Value* args) {
-    if(arg_count != 1) { return FERROR_VAL(FE_ARG_COUNT_1); }
-    if(!IS_USERARRAY(args[0])) { return FERROR_VAL(FE_ARG_1_ARRAY); }
-
     ObjUserArray* ua = AS_USERARRAY(args[0]);
 
     if(ua->inner.count == 0) {
@@ -346,29 +403,21 @@ Value cc_function_ar_shift(int arg_count, Value* args) {
     }
 
     Value old_value = ua->inner.values[0];
-    for(int i = 1; i < ua->inner.count; i++) {
-        int j = i - 1;
-        ua->inner.values[j] = ua->inner.values[i];
-    }
-    ua->inner.values[ua->inner.count - 1] = NIL_VAL;
-    ua->inner.count--;
+    ua_drop_front(ua, 1);
     return old_value;
 }
 
 
 /**
  * ar_clone(user_array)
- * - returns nil on parameter error
+ * - raises an error if the arguments are the wrong number or type
  * - returns a new identical copy of the original array
  */
 Value cc_function_ar_clone(int arg_count, Value* args) {
-    if(arg_count != 1) { return FERROR_VAL(FE_ARG_COUNT_1); }
-    if(!IS_USERARRAY(args[0])) { return FERROR_VAL(FE_ARG_1_ARRAY); }
-
     ObjUserArray* ua = AS_USERARRAY(args[0]);
     ObjUserArray* new_ua = newUserArray();
     ua_grow(new_ua, ua->inner.count);
-    for(int i = 0; i < ua->inner.count; i++) {
+    for(int64_t i = 0; i < ua->inner.count; i++) {
         new_ua->inner.values[i] = ua->inner.values[i];
     }
     new_ua->inner.count = ua->inner.count;
@@ -378,7 +427,7 @@ Value cc_function_ar_clone(int arg_count, Value* args) {
 
 /**
  * ar_find(user_array, value, starting_index?)
- * - returns nil on parameter error
+ * - raises an error if the arguments are the wrong number or type
  * - returns nil if the the given starting index is out of bounds of the array
  *   !! Again, a variation here, normally this returns false, but we return
  *      nil here to allow a distingiusihing between bad params and not finding
@@ -388,17 +437,13 @@ Value cc_function_ar_clone(int arg_count, Value* args) {
  *   after the starting index, which is the start of the array unless specified.
  */
 Value cc_function_ar_find(int arg_count, Value* args) {
-    if(arg_count < 2 || arg_count > 3) { return FERROR_VAL(FE_ARG_COUNT_2_3); }
-    if(!IS_USERARRAY(args[0])) { return FERROR_VAL(FE_ARG_1_ARRAY); }
-    if(arg_count == 3 && !IS_NUMBER(args[2])) { return FERROR_VAL(FE_ARG_3_NUMBER); }
-
     ObjUserArray* ua = AS_USERARRAY(args[0]);
     if(ua->inner.count == 0) {
         return BOOL_VAL(false);
     }
 
     Value target_value = args[1];
-    int16_t minimum_index = 0;
+    int64_t minimum_index = 0;
     if(arg_count == 3 && IS_NUMBER(args[2])) {
         minimum_index = ua_normalize_index(ua, AS_NUMBER(args[2]), true);
         if(minimum_index < 0) {
@@ -406,7 +451,7 @@ Value cc_function_ar_find(int arg_count, Value* args) {
         }
     }
 
-    for(int i = minimum_index; i < ua->inner.count; i++) {
+    for(int64_t i = minimum_index; i < ua->inner.count; i++) {
         if(valuesEqual(target_value, ua->inner.values[i])) {
             return NUMBER_VAL(i);
         }
@@ -417,18 +462,14 @@ Value cc_function_ar_find(int arg_count, Value* args) {
 
 /**
  * ar_chunk(user_array, chunk_size)
- * - returns nil on parameter error
+ * - raises an error if the arguments are the wrong number or type
  * - returns an array composed of arrays of chunk_size, each holding values taken
  *   from the source array, in the original order.
  */
 Value cc_function_ar_chunk(int arg_count, Value* args) {
-    if(arg_count != 2) { return FERROR_VAL(FE_ARG_COUNT_2); }
-    if(!IS_USERARRAY(args[0])) { return FERROR_VAL(FE_ARG_1_ARRAY); }
-    if(!IS_STRING(args[1])) { return FERROR_VAL(FE_ARG_2_STRING); }
-
     ObjUserArray* ua = AS_USERARRAY(args[0]);
 
-    int16_t chunk_size = (int16_t)AS_NUMBER(args[1]);
+    int64_t chunk_size = (int64_t)AS_NUMBER(args[1]);
     if(chunk_size < 1) {
         return NIL_VAL;
     }
@@ -437,14 +478,14 @@ Value cc_function_ar_chunk(int arg_count, Value* args) {
     // chunk_size long.  We'll start by creating a new User Array with enough
     // capacity to hold all of the child arrays.
     ObjUserArray* result_array = newUserArray();
-    int16_t outer_capacity = (int16_t)ceil( (double)ua->inner.count / (double)chunk_size );
+    int64_t outer_capacity = (int64_t)ceil( (double)ua->inner.count / (double)chunk_size );
     ua_grow(result_array, outer_capacity);
 
-    int chunk_counter = 0;
-    int result_index = 0;
+    int64_t chunk_counter = 0;
+    int64_t result_index = 0;
     result_array->inner.values[result_index] = OBJ_VAL(newUserArray());
     result_array->inner.count = 1;
-    for(int i = 0; i < ua->inner.count; i++) {
+    for(int64_t i = 0; i < ua->inner.count; i++) {
         // Each chunk is always a maximum size, so we can adjust it immediately.
         ObjUserArray* target_array = AS_USERARRAY(result_array->inner.values[result_index]);
         if(target_array->inner.capacity < chunk_size) {
@@ -468,23 +509,20 @@ Value cc_function_ar_chunk(int arg_count, Value* args) {
 
 /**
  * ar_shuffle(user_array)
- * - returns nil on parameter error
+ * - raises an error if the arguments are the wrong number or type
  * - returns a copy of the original array with the values shuffled around by RNG
  */
 Value cc_function_ar_shuffle(int arg_count, Value* args) {
-    if(arg_count != 1) { return FERROR_VAL(FE_ARG_COUNT_1); }
-    if(!IS_USERARRAY(args[0])) { return FERROR_VAL(FE_ARG_1_ARRAY); }
-
     ObjUserArray* ua = AS_USERARRAY(args[0]);
     ObjUserArray* target_array = newUserArray();
     ua_grow(target_array, ua->inner.count);
 
-    for(int i = 0; i < ua->inner.count; i++) {
+    for(int64_t i = 0; i < ua->inner.count; i++) {
         target_array->inner.values[i] = ua->inner.values[i];
         target_array->inner.count++;
     }
-    for(int i = 0; i < target_array->inner.count; i++) {
-        int swap_index = (int)random_int(0, target_array->inner.count - 1);
+    for(int64_t i = 0; i < target_array->inner.count; i++) {
+        int64_t swap_index = (int64_t)random_int(0, target_array->inner.count - 1);
         Value old_value = target_array->inner.values[i];
         target_array->inner.values[i] = target_array->inner.values[swap_index];
         target_array->inner.values[swap_index] = old_value;
@@ -495,18 +533,15 @@ Value cc_function_ar_shuffle(int arg_count, Value* args) {
 
 /**
  * ar_reverse(user_array)
- * - returns nil on parameter error
+ * - raises an error if the arguments are the wrong number or type
  * - returns a copy of the original array with the values reversed
  */
 Value cc_function_ar_reverse(int arg_count, Value* args) {
-    if(arg_count != 1) { return FERROR_VAL(FE_ARG_COUNT_1); }
-    if(!IS_USERARRAY(args[0])) { return FERROR_VAL(FE_ARG_1_ARRAY); }
-
     ObjUserArray* ua = AS_USERARRAY(args[0]);
     ObjUserArray* target_array = newUserArray();
     ua_grow(target_array, ua->inner.count);
 
-    for(int i = 0; i < ua->inner.count; i++) {
+    for(int64_t i = 0; i < ua->inner.count; i++) {
         target_array->inner.values[ ua->inner.count - 1 - i ] = ua->inner.values[i];
         target_array->inner.count++;
     }
@@ -516,18 +551,13 @@ Value cc_function_ar_reverse(int arg_count, Value* args) {
 
 /**
  * ar_slice(user_array, index, count?)
- * - returns nil on parameter error
+ * - raises an error if the arguments are the wrong number or type
  * - returns false if the the given index is out of bounds of the array
  * - returns a new array copied from the existing array, starting at the passed
  *   index.  If a count is passed, only that many elements are copied.  If no
  *   count is passed, all remaining array elements are copied.
  */
 Value cc_function_ar_slice(int arg_count, Value* args) {
-    if(arg_count < 2 || arg_count > 3) { return FERROR_VAL(FE_ARG_COUNT_2_3); }
-    if(!IS_USERARRAY(args[0])) { return FERROR_VAL(FE_ARG_1_ARRAY); }
-    if(!IS_NUMBER(args[1])) { return FERROR_VAL(FE_ARG_2_NUMBER); }
-    if(arg_count == 3 && !IS_NUMBER(args[2])) { return FERROR_VAL(FE_ARG_3_NUMBER); }
-
     ObjUserArray* ua = AS_USERARRAY(args[0]);
     double raw_range = 0;
     if(arg_count == 3 && IS_NUMBER(args[2])) {
@@ -543,7 +573,7 @@ Value cc_function_ar_slice(int arg_count, Value* args) {
 
     ObjUserArray* new_ua = newUserArray();
     ua_grow(new_ua, legal.range);
-    for(int i = legal.index; i < legal.index + legal.range; i++) {
+    for(int64_t i = legal.index; i < legal.index + legal.range; i++) {
         new_ua->inner.values[ new_ua->inner.count++ ] = ua->inner.values[i];
     }
     return OBJ_VAL(new_ua);
@@ -552,21 +582,16 @@ Value cc_function_ar_slice(int arg_count, Value* args) {
 
 /**
  * ar_insert(user_array, index, donor_array)
- * - returns nil on parameter error
+ * - raises an error if the arguments are the wrong number or type
  * - returns false if the the given index is out of bounds of the array
  * - returns a new array with the contents of the donor array inserted into the
  *   user array, starting at the given idex of the user array.  If the index is
  *   larger than the user array, nils are inserted before inserting the donor.
  */
 Value cc_function_ar_insert(int arg_count, Value* args) {
-    if(arg_count != 3) { return FERROR_VAL(FE_ARG_COUNT_3); }
-    if(!IS_USERARRAY(args[0])) { return FERROR_VAL(FE_ARG_1_ARRAY); }
-    if(!IS_NUMBER(args[1])) { return FERROR_VAL(FE_ARG_2_NUMBER); }
-    if(!IS_USERARRAY(args[2])) { return FERROR_VAL(FE_ARG_3_ARRAY); }
-
     ObjUserArray* left = AS_USERARRAY(args[0]);
     ObjUserArray* right = AS_USERARRAY(args[2]);
-    int16_t target_index = ua_normalize_index(left, AS_NUMBER(args[1]), false);
+    int64_t target_index = ua_normalize_index(left, AS_NUMBER(args[1]), false);
     if(target_index < 0) {
         return BOOL_VAL(false);
     }
@@ -574,7 +599,7 @@ Value cc_function_ar_insert(int arg_count, Value* args) {
     // We aren't doing bounds checking on the insert index.  If it's geater than
     // our size, we will need to insert blanks at the end of the section to the
     // left of the insert.
-    int addtl = target_index - left->inner.count;
+    int64_t addtl = target_index - left->inner.count;
     if(addtl < 0) {
         addtl = 0;
     }
@@ -584,26 +609,17 @@ Value cc_function_ar_insert(int arg_count, Value* args) {
 
     // We can stop anywhere inside the first array, or even outside of its bounds.
     // Make sure that we don't go out of index during the first step.
-    int first_stop = addtl > 0 ? left->inner.count : target_index;
+    int64_t first_stop = addtl > 0 ? left->inner.count : target_index;
 
     // Step 1: Copy from the left array up to the bounary.
-    for(int i = 0; i < first_stop; i++) {
-        new_ua->inner.values[ new_ua->inner.count++ ] = left->inner.values[i];
-    }
-    // Step 2: Insert blanks to hit the target index
-    if(addtl > 0) {
-        for(int i = 0; i < addtl; i++) {
-            new_ua->inner.values[ new_ua->inner.count++ ] = NIL_VAL;
-        }
-    }
+    ua_copy_values(new_ua, left->inner.values, first_stop);
+    // Step 2: Insert blanks to hit the target index.  ua_grow() already made
+    // every slot past the end nil.
+    new_ua->inner.count += addtl;
     // Step 3: Insert the right array
-    for(int i = 0; i < right->inner.count; i++) {
-        new_ua->inner.values[ new_ua->inner.count++ ] = right->inner.values[i];
-    }
+    ua_copy_values(new_ua, right->inner.values, right->inner.count);
     // Step 4: Finish copying from the left array
-    for(int i = first_stop; i < left->inner.count; i++) {
-        new_ua->inner.values[ new_ua->inner.count++ ] = left->inner.values[i];
-    }
+    ua_copy_values(new_ua, &left->inner.values[first_stop], left->inner.count - first_stop);
 
     return OBJ_VAL(new_ua);
 }
@@ -611,38 +627,26 @@ Value cc_function_ar_insert(int arg_count, Value* args) {
 
 /**
  * ar_append(user_array, donor_array)
- * - returns nil on parameter error
+ * - raises an error if the arguments are the wrong number or type
  * - returns a copy of the original with the elements from donor array appended
  */
 Value cc_function_ar_append(int arg_count, Value* args) {
-    if(arg_count != 2) { return FERROR_VAL(FE_ARG_COUNT_2); }
-    if(!IS_USERARRAY(args[0])) { return FERROR_VAL(FE_ARG_1_ARRAY); }
-    if(!IS_USERARRAY(args[1])) { return FERROR_VAL(FE_ARG_2_ARRAY); }
-
     ObjUserArray* left = AS_USERARRAY(args[0]);
     ObjUserArray* right = AS_USERARRAY(args[1]);
     ObjUserArray* new_ua = newUserArray();
     ua_grow(new_ua, left->inner.count + right->inner.count);
-    for(int i = 0; i < left->inner.count; i++) {
-        new_ua->inner.values[ new_ua->inner.count++ ] = left->inner.values[i];
-    }
-    for(int i = 0; i < right->inner.count; i++) {
-        new_ua->inner.values[ new_ua->inner.count++ ] = right->inner.values[i];
-    }
+    ua_copy_values(new_ua, left->inner.values, left->inner.count);
+    ua_copy_values(new_ua, right->inner.values, right->inner.count);
     return OBJ_VAL(new_ua);
 }
 
 
 /**
  * ar_prepend(user_array, donor_array)
- * - returns nil on parameter error
+ * - raises an error if the arguments are the wrong number or type
  * - returns a copy of the original with the elements from donor array prepended
  */
 Value cc_function_ar_prepend(int arg_count, Value* args) {
-    if(arg_count != 2) { return FERROR_VAL(FE_ARG_COUNT_2); }
-    if(!IS_USERARRAY(args[0])) { return FERROR_VAL(FE_ARG_1_ARRAY); }
-    if(!IS_USERARRAY(args[1])) { return FERROR_VAL(FE_ARG_2_ARRAY); }
-
     // lol
     Value swap = args[0];
     args[0] = args[1];
@@ -710,8 +714,8 @@ static int8_t sort_value_pair(Value example, Value specimen) {
                             // compare our key counts.  If I have more keys than
                             // the given specimen, it is sorted lower than me,
                             // etc etc.
-                            int example_count = AS_USERHASH(example)->table.count;
-                            int specimen_count = AS_USERHASH(specimen)->table.count;
+                            int64_t example_count = AS_USERHASH(example)->table.count;
+                            int64_t specimen_count = AS_USERHASH(specimen)->table.count;
                             if(specimen_count > example_count) {
                                 return 1;
                             } else if(example_count > specimen_count) {
@@ -721,8 +725,8 @@ static int8_t sort_value_pair(Value example, Value specimen) {
                         }
                         case OBJ_USERARRAY: {
                             // Like user hashes, arrays are sorted by key count.
-                            int example_count = AS_USERARRAY(example)->inner.count;
-                            int specimen_count = AS_USERARRAY(specimen)->inner.count;
+                            int64_t example_count = AS_USERARRAY(example)->inner.count;
+                            int64_t specimen_count = AS_USERARRAY(specimen)->inner.count;
                             if(specimen_count > example_count) {
                                 return 1;
                             } else if(example_count > specimen_count) {
@@ -850,164 +854,702 @@ static int8_t sort_value_pair(Value example, Value specimen) {
 }
 
 
-static void quicksort_recursive(int min_index, int max_index, Value* values) {
-    // Don't attempt to sort lists of size 0 or 1.
-    if(max_index - max_index < 2) {
-        return;
+/*
+    ar_sort() uses introsort: quicksort with a median-of-three pivot, which
+    splits sorted and reverse-sorted input evenly; insertion sort once a range
+    is down to UA_INSERTION_SORT_MAX elements; and heapsort for any range that
+    is still being partitioned after 2 * log2(n) rounds, so a run of bad
+    pivots can never go quadratic.
+
+    The same algorithm gets stamped out once per comparator by the macro below,
+    so the comparison inlines instead of going through a function pointer.
+    Arrays of nothing but strings are sorted with strcmp(), and everything
+    else with sort_value_pair().  Short arrays of nothing but numbers are
+    sorted as plain doubles; longer ones don't compare at all, see
+    ua_radix_sort() below.
+*/
+#define UA_INSERTION_SORT_MAX 16
+
+#define UA_DEFINE_INTROSORT(prefix, type, less) \
+static void prefix##_insertion_sort(type* values, int64_t count) { \
+    for(int64_t i = 1; i < count; i++) { \
+        type value = values[i]; \
+        int64_t j = i; \
+        while(j > 0 && less(value, values[j - 1])) { \
+            values[j] = values[j - 1]; \
+            j--; \
+        } \
+        values[j] = value; \
+    } \
+} \
+\
+static void prefix##_sift_down(type* values, int64_t root, int64_t count) { \
+    type value = values[root]; \
+    for(;;) { \
+        int64_t child = root * 2 + 1; \
+        if(child >= count) { \
+            break; \
+        } \
+        if(child + 1 < count && less(values[child], values[child + 1])) { \
+            child++; \
+        } \
+        if(!less(value, values[child])) { \
+            break; \
+        } \
+        values[root] = values[child]; \
+        root = child; \
+    } \
+    values[root] = value; \
+} \
+\
+static void prefix##_heapsort(type* values, int64_t count) { \
+    for(int64_t i = count / 2 - 1; i >= 0; i--) { \
+        prefix##_sift_down(values, i, count); \
+    } \
+    for(int64_t i = count - 1; i > 0; i--) { \
+        type largest = values[0]; \
+        values[0] = values[i]; \
+        values[i] = largest; \
+        prefix##_sift_down(values, 0, i); \
+    } \
+} \
+\
+static type prefix##_median_of_three(type a, type b, type c) { \
+    if(less(a, b)) { \
+        if(less(b, c)) return b; \
+        return less(a, c) ? c : a; \
+    } \
+    if(less(a, c)) return a; \
+    return less(b, c) ? c : b; \
+} \
+\
+/* The pivot is the median of three elements of the range, so there is always \
+   something on either side to stop the scans without bounds checks, and both \
+   halves come out non-empty. */ \
+static int64_t prefix##_partition(type* values, int64_t count, type pivot) { \
+    int64_t first = 0; \
+    int64_t last = count; \
+    for(;;) { \
+        while(less(values[first], pivot)) { \
+            first++; \
+        } \
+        last--; \
+        while(less(pivot, values[last])) { \
+            last--; \
+        } \
+        if(first >= last) { \
+            return first; \
+        } \
+        type swap = values[first]; \
+        values[first] = values[last]; \
+        values[last] = swap; \
+        first++; \
+    } \
+} \
+\
+static void prefix##_introsort_loop(type* values, int64_t count, int depth_limit) { \
+    while(count > UA_INSERTION_SORT_MAX) { \
+        if(depth_limit-- == 0) { \
+            prefix##_heapsort(values, count); \
+            return; \
+        } \
+        type pivot = prefix##_median_of_three( \
+            values[0], values[count / 2], values[count - 1] \
+        ); \
+        int64_t cut = prefix##_partition(values, count, pivot); \
+        /* Recurse into the smaller half and loop on the larger one, which \
+           keeps the C stack at O(log n). */ \
+        if(cut < count - cut) { \
+            prefix##_introsort_loop(values, cut, depth_limit); \
+            values += cut; \
+            count -= cut; \
+        } else { \
+            prefix##_introsort_loop(values + cut, count - cut, depth_limit); \
+            count = cut; \
+        } \
+    } \
+    prefix##_insertion_sort(values, count); \
+} \
+\
+static void prefix##_introsort(type* values, int64_t count) { \
+    int depth_limit = 0; \
+    for(int64_t n = count; n > 1; n >>= 1) { \
+        depth_limit += 2; \
+    } \
+    prefix##_introsort_loop(values, count, depth_limit); \
+}
+
+#define ua_number_less(a, b) ((a) < (b))
+#define ua_string_less(a, b) (strcmp(AS_CSTRING(a), AS_CSTRING(b)) < 0)
+#define ua_value_less(a, b) (sort_value_pair((a), (b)) > 0)
+
+UA_DEFINE_INTROSORT(ua_number, double, ua_number_less)
+UA_DEFINE_INTROSORT(ua_string, Value, ua_string_less)
+UA_DEFINE_INTROSORT(ua_value, Value, ua_value_less)
+
+
+typedef enum {
+    UA_SORT_NUMBERS,
+    UA_SORT_STRINGS,
+    UA_SORT_MIXED
+} UA_Sort_Kind;
+
+
+static UA_Sort_Kind ua_sort_kind(Value* values, int64_t count) {
+    bool all_numbers = true;
+    bool all_strings = true;
+    for(int64_t i = 0; i < count && (all_numbers || all_strings); i++) {
+        if(!IS_NUMBER(values[i])) {
+            all_numbers = false;
+        }
+        if(!IS_STRING(values[i])) {
+            all_strings = false;
+        }
     }
+    if(all_numbers) {
+        return UA_SORT_NUMBERS;
+    }
+    return all_strings ? UA_SORT_STRINGS : UA_SORT_MIXED;
+}
+
+
 /*
-    An explanation of quicksort based on:
-    https://www.khanacademy.org/computing/computer-science/algorithms/quick-sort/a/overview-of-quicksort
-    https://www.khanacademy.org/computing/computer-science/algorithms/quick-sort/a/linear-time-partitioning
+    Arrays of nothing but numbers get an LSD radix sort over the bits of the
+    doubles, a byte at a time.  Flipping the sign bit of positive numbers and
+    every bit of negative ones turns the IEEE-754 layout into unsigned
+    integers that sort in the same order as the numbers, so eight counting
+    passes sort any amount of input in linear time.  All eight histograms are
+    built in a single pass up front, and a byte that is the same in every key
+    skips its pass: integers, timestamps and byte counts usually only need
+    three to five.
+
+    NaN sorts below everything else, so NaNs are moved to the front first and
+    left out of the radix sort.  -0 ends up before 0, which is as good as any
+    other order for two values that compare equal.  Below UA_RADIX_SORT_MIN
+    elements the histograms cost more than they save, and introsort runs on
+    the plain doubles instead.
+*/
+#define UA_RADIX_SORT_MIN 1024
+#define UA_RADIX_BITS 8
+#define UA_RADIX_BUCKETS (1 << UA_RADIX_BITS)
+#define UA_RADIX_PASSES (64 / UA_RADIX_BITS)
+
+
+static inline uint64_t ua_radix_key(double number) {
+    uint64_t bits;
+    memcpy(&bits, &number, sizeof(bits));
+    return bits >> 63 ? ~bits : bits | 0x8000000000000000ull;
+}
 
-    Those documents describe keeping track of multiple indexes for the various
-    parts of the array, but as you will see, we really only need to keep track
-    of the gt index.  Everything else can be derived from the passed min and
-    max indexes, given that we always pivot on the final index.  (The lte index
-    is always min_index!)
 
-    We are given an array of Values, and a range to operate within that array.
-    We select the last element of the array.  This is our pivot value.  We will
-    partition the array into two sections: those less than or equal to the pivot,
-    and those that are larger than the pivot.
+static inline double ua_radix_number(uint64_t key) {
+    uint64_t bits = key >> 63 ? key & 0x7fffffffffffffffull : ~key;
+    double number;
+    memcpy(&number, &bits, sizeof(number));
+    return number;
+}
 
-    We will keep track of these partitions by keeping two indexes:
-    1) The index of the start of the lte values, initially 0
-    2) The index of the start of the gt values, initially 0
 
-    We will iterate through the array and compare each value to the pivot.
+// Sorts count keys, ping-ponging between keys and scratch.  Returns whichever
+// of the two ended up holding the result.
+static uint64_t* ua_radix_sort(uint64_t* keys, uint64_t* scratch, int64_t count) {
+    uint64_t histograms[UA_RADIX_PASSES][UA_RADIX_BUCKETS];
+    memset(histograms, 0, sizeof(histograms));
+    for(int64_t i = 0; i < count; i++) {
+        uint64_t key = keys[i];
+        for(int pass = 0; pass < UA_RADIX_PASSES; pass++) {
+            histograms[pass][(key >> (pass * UA_RADIX_BITS)) & (UA_RADIX_BUCKETS - 1)]++;
+        }
+    }
+
+    for(int pass = 0; pass < UA_RADIX_PASSES; pass++) {
+        uint64_t* histogram = histograms[pass];
+        int shift = pass * UA_RADIX_BITS;
+        if(histogram[(keys[0] >> shift) & (UA_RADIX_BUCKETS - 1)] == (uint64_t)count) {
+            continue;
+        }
 
-    Here's our sample array:
-    0     1     2     3     4     5     6     7
-    [15]  [17]  [11]  [12]  [19]  [11]  [13]  [14]
-    (lte)
-    (gt)
+        uint64_t offset = 0;
+        for(int bucket = 0; bucket < UA_RADIX_BUCKETS; bucket++) {
+            uint64_t bucket_count = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucket_count;
+        }
+        for(int64_t i = 0; i < count; i++) {
+            uint64_t key = keys[i];
+            scratch[histogram[(key >> shift) & (UA_RADIX_BUCKETS - 1)]++] = key;
+        }
 
-    Our pivot is index 7, value 14.
+        uint64_t* swap = keys;
+        keys = scratch;
+        scratch = swap;
+    }
+    return keys;
+}
 
-    Start by comparing element 0 to our pivot.  It's greater than the pivot.  The
-    gt index is checked.  Because we are inside the gt range, we will do nothing.
 
-    Element 1 is next.  Again because it's greater than the pivot, and we're inside
-    the gt range, we will do nothing.
+/*
+    Big arrays of numbers or strings are sorted on every thread in the worker
+    pool, since their comparisons never leave C.  The array is cut into one
+    run per thread and the runs are sorted at the same time, then merged in
+    rounds, doubling the run length each time.  Every round is split evenly
+    across the threads by output position rather than by pair of runs: each
+    slice finds where it starts in both of its input runs with a binary search
+    (the co-rank), so the last round, a single merge of two halves, still
+    keeps every thread busy.
+*/
+#define UA_PARALLEL_SORT_MIN 16384
+
+typedef struct {
+    void* values;
+    void* scratch;
+    int64_t count;
+    int threads;
+    // Runs are this long in values, apart from the last one.
+    int64_t width;
+} UA_Parallel_Sort;
+
+#define UA_DEFINE_PARALLEL_MERGE(prefix, type, less) \
+/* How many of the first k elements of the merge of a and b come from a.  Ties \
+   go to a, which keeps the merge stable. */ \
+static int64_t prefix##_co_rank(type* a, int64_t a_count, type* b, int64_t b_count, int64_t k) { \
+    int64_t low = k > b_count ? k - b_count : 0; \
+    int64_t high = k < a_count ? k : a_count; \
+    while(low < high) { \
+        int64_t i = low + (high - low) / 2; \
+        if(less(b[k - i - 1], a[i])) { \
+            high = i; \
+        } else { \
+            low = i + 1; \
+        } \
+    } \
+    return low; \
+} \
+\
+static void prefix##_merge_slice(void* context, int index) { \
+    UA_Parallel_Sort* sort = context; \
+    type* source = sort->values; \
+    type* target = sort->scratch; \
+    int64_t pair_width = sort->width * 2; \
+    int64_t first = sort->count * index / sort->threads; \
+    int64_t last = sort->count * (index + 1) / sort->threads; \
+    while(first < last) { \
+        int64_t start = first / pair_width * pair_width; \
+        int64_t middle = start + sort->width < sort->count ? start + sort->width : sort->count; \
+        int64_t end = middle + sort->width < sort->count ? middle + sort->width : sort->count; \
+        int64_t stop = last < end ? last : end; \
+        type* a = source + start; \
+        type* b = source + middle; \
+        int64_t i = prefix##_co_rank(a, middle - start, b, end - middle, first - start); \
+        int64_t j = first - start - i; \
+        int64_t i_end = prefix##_co_rank(a, middle - start, b, end - middle, stop - start); \
+        int64_t j_end = stop - start - i_end; \
+        type* out = target + first; \
+        while(i < i_end && j < j_end) { \
+            *out++ = less(b[j], a[i]) ? b[j++] : a[i++]; \
+        } \
+        while(i < i_end) { \
+            *out++ = a[i++]; \
+        } \
+        while(j < j_end) { \
+            *out++ = b[j++]; \
+        } \
+        first = stop; \
+    } \
+}
+
+#define ua_key_number_less(a, b) ((a) < (b))
+
+UA_DEFINE_PARALLEL_MERGE(ua_key, uint64_t, ua_key_number_less)
+UA_DEFINE_PARALLEL_MERGE(ua_string, Value, ua_string_less)
+
+
+static void ua_radix_sort_run(void* context, int index) {
+    UA_Parallel_Sort* sort = context;
+    int64_t start = sort->width * index;
+    if(start >= sort->count) {
+        return;
+    }
+    int64_t count = start + sort->width < sort->count ? sort->width : sort->count - start;
+    uint64_t* keys = (uint64_t*)sort->values + start;
+    uint64_t* sorted = ua_radix_sort(keys, (uint64_t*)sort->scratch + start, count);
+    if(sorted != keys) {
+        memcpy(keys, sorted, count * sizeof(uint64_t));
+    }
+}
+
+
+static void ua_string_sort_run(void* context, int index) {
+    UA_Parallel_Sort* sort = context;
+    int64_t start = sort->width * index;
+    if(start >= sort->count) {
+        return;
+    }
+    int64_t count = start + sort->width < sort->count ? sort->width : sort->count - start;
+    ua_string_introsort((Value*)sort->values + start, count);
+}
 
-    Element 2 is next.  It is lte to the pivot.  We will swap it with the first
-    index of the gt list (element 0), and then increment the gt index by one.
-    The array now looks like:
 
-    0     1     2     3     4     5     6     7
-    [11]  [17]  [15]  [12]  [19]  [11]  [13]  [14]
-    (lte) (gt)                                (p)
+// Leaves the sorted elements in values; scratch must be as big.
+static void ua_parallel_sort(
+    void* values, void* scratch, int64_t count, size_t size,
+    WorkerTask sort_run, WorkerTask merge_slice
+) {
+    UA_Parallel_Sort sort;
+    sort.values = values;
+    sort.scratch = scratch;
+    sort.count = count;
+    sort.threads = workerCount();
+    sort.width = (count + sort.threads - 1) / sort.threads;
+
+    workersRun(sort_run, &sort, sort.threads);
+    while(sort.width < count) {
+        workersRun(merge_slice, &sort, sort.threads);
+        void* swap = sort.values;
+        sort.values = sort.scratch;
+        sort.scratch = swap;
+        sort.width = sort.width > count / 2 ? count : sort.width * 2;
+    }
+    if(sort.values != values) {
+        memcpy(values, sort.values, count * size);
+    }
+}
 
-    Element 3 is next.  It is lte to the pivot.  Swap it with the first index of
-    the gt list, inc the gt index.
 
-    0     1     2     3     4     5     6     7
-    [11]  [12]  [15]  [17]  [19]  [11]  [13]  [14]
-    (lte)       (gt)                          (p)
+static bool ua_sort_in_parallel(int64_t count) {
+    return count >= UA_PARALLEL_SORT_MIN && workerCount() > 1;
+}
 
-    Element 4 is next.  It is larger and inside the gt range, so we skip.
 
-    Element 5 is next.  It is smaller.  Swap it with the gt index, inc gt.
+static void ua_sort_numbers(Value* values, int64_t count) {
+    int64_t nans = 0;
+    for(int64_t i = 0; i < count; i++) {
+        if(isnan(AS_NUMBER(values[i]))) {
+            Value nan = values[i];
+            values[i] = values[nans];
+            values[nans++] = nan;
+        }
+    }
+    values += nans;
+    count -= nans;
 
-    0     1     2     3     4     5     6     7
-    [11]  [12]  [11]  [17]  [19]  [15]  [13]  [14]
-    (lte)             (gt)                    (p)
+    if(count < UA_RADIX_SORT_MIN) {
+        double* numbers = ALLOCATE(double, count);
+        for(int64_t i = 0; i < count; i++) {
+            numbers[i] = AS_NUMBER(values[i]);
+        }
+        ua_number_introsort(numbers, count);
+        for(int64_t i = 0; i < count; i++) {
+            values[i] = NUMBER_VAL(numbers[i]);
+        }
+        FREE_ARRAY(double, numbers, count);
+        return;
+    }
 
-    Element 6 is smaller, swap with gt, inc gt.
+    uint64_t* keys = ALLOCATE(uint64_t, count * 2);
+    for(int64_t i = 0; i < count; i++) {
+        keys[i] = ua_radix_key(AS_NUMBER(values[i]));
+    }
+    uint64_t* sorted = keys;
+    if(ua_sort_in_parallel(count)) {
+        ua_parallel_sort(
+            keys, keys + count, count, sizeof(uint64_t),
+            ua_radix_sort_run, ua_key_merge_slice
+        );
+    } else {
+        sorted = ua_radix_sort(keys, keys + count, count);
+    }
+    for(int64_t i = 0; i < count; i++) {
+        values[i] = NUMBER_VAL(ua_radix_number(sorted[i]));
+    }
+    FREE_ARRAY(uint64_t, keys, count * 2);
+}
 
-    0     1     2     3     4     5     6     7
-    [11]  [12]  [11]  [13]  [19]  [15]  [17]  [14]
-    (lte)                   (gt)              (p)
 
-    We're done with the first step.  Swap the gt index and the pivot, then inc gt.
+static void ua_sort_values(Value* values, int64_t count) {
+    if(count < 2) {
+        return;
+    }
+    switch(ua_sort_kind(values, count)) {
+        case UA_SORT_NUMBERS:
+            ua_sort_numbers(values, count);
+            break;
+        case UA_SORT_STRINGS:
+            if(ua_sort_in_parallel(count)) {
+                Value* scratch = ALLOCATE(Value, count);
+                ua_parallel_sort(
+                    values, scratch, count, sizeof(Value),
+                    ua_string_sort_run, ua_string_merge_slice
+                );
+                FREE_ARRAY(Value, scratch, count);
+            } else {
+                ua_string_introsort(values, count);
+            }
+            break;
+        case UA_SORT_MIXED:
+            ua_value_introsort(values, count);
+            break;
+    }
+}
 
-    0     1     2     3     4     5     6     7
-    [11]  [12]  [11]  [13]  [14]  [15]  [17]  [19]
-    (lte)                   (p)   (gt)
 
-    Recursion time.  Sort the left half of the array, from the min index through
-    to the pivot.  Then sort the right half of the array, from the gt index
-    through to max index.
+/*
+    ar_sort_callback() and ar_sort_by() use a stable merge sort in the style of
+    timsort, because every comparison in ar_sort_callback() is a trip back into
+    the interpreter.  It finds the runs already in the input (reversing
+    strictly descending ones), extends short runs with binary insertion sort,
+    and merges runs off a stack that keeps their lengths balanced.  Before each
+    merge, binary searches trim the elements already in their final place, so
+    sorted and nearly sorted input needs O(n) comparisons.
 */
-    int pivot_index = max_index;
-    int gt_index = min_index;
-    Value pivot = values[pivot_index];
-    for(int i = min_index; i < pivot_index; i++) {
-        Value specimen = values[i];
-        if(sort_value_pair(pivot, specimen) < 1) {
-        // The specimen value is sorted lower than or equal to the pivot.  Move it
-        // to the end of the lte section, which is denoted by the gt index.
-        // As the lte section grows, the gt index will increment accordingly.
-            values[i] = values[gt_index];
-            values[gt_index] = specimen;
-            gt_index++;
+#define UA_MIN_MERGE 32
+#define UA_MAX_RUNS 85
+
+typedef struct UA_Merge_Sort UA_Merge_Sort;
+
+struct UA_Merge_Sort {
+    // True if a belongs strictly before b.
+    bool (*less)(UA_Merge_Sort* sort, Value a, Value b);
+    Value callback;
+    Value* keys;
+    Value* scratch;
+    int64_t run_base[UA_MAX_RUNS];
+    int64_t run_length[UA_MAX_RUNS];
+    int64_t run_count;
+    // A runtime error inside the callback resets the VM's frames.  Once that
+    // happens, the callback is left alone and the sort just runs out.
+    int64_t frame_count;
+    bool failed;
+};
+
+
+static bool ua_callback_less(UA_Merge_Sort* sort, Value a, Value b) {
+    if(sort->failed) {
+        return false;
+    }
+    Value callback_args[2] = { a, b };
+    Value sort_result = callCallback(sort->callback, 2, callback_args);
+    if(vm.frameCount < sort->frame_count) {
+        sort->failed = true;
+        return false;
+    }
+    // The specimen, b, is sorted above the example, a.  Non-numbers mean equal.
+    return IS_NUMBER(sort_result) && AS_NUMBER(sort_result) > 0;
+}
+
+
+// ar_sort_by() sorts the indexes of its elements, as numbers, by their keys.
+static bool ua_key_less(UA_Merge_Sort* sort, Value a, Value b) {
+    Value left = sort->keys[(int64_t)AS_NUMBER(a)];
+    Value right = sort->keys[(int64_t)AS_NUMBER(b)];
+    if(IS_NUMBER(left) && IS_NUMBER(right) &&
+       !isnan(AS_NUMBER(left)) && !isnan(AS_NUMBER(right))) {
+        return AS_NUMBER(left) < AS_NUMBER(right);
+    }
+    return sort_value_pair(left, right) > 0;
+}
+
+
+// The number of elements in values[0..count) that key doesn't belong before,
+// so inserting key there keeps it after anything equal.
+static int64_t ua_upper_bound(UA_Merge_Sort* sort, Value* values, int64_t count, Value key) {
+    int64_t low = 0;
+    int64_t high = count;
+    while(low < high) {
+        int64_t middle = low + (high - low) / 2;
+        if(sort->less(sort, key, values[middle])) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+    return low;
+}
+
+
+// The number of elements in values[0..count) that belong before key.
+static int64_t ua_lower_bound(UA_Merge_Sort* sort, Value* values, int64_t count, Value key) {
+    int64_t low = 0;
+    int64_t high = count;
+    while(low < high) {
+        int64_t middle = low + (high - low) / 2;
+        if(sort->less(sort, values[middle], key)) {
+            low = middle + 1;
+        } else {
+            high = middle;
         }
     }
-    // We've now split the array into two sections:
-    // min_index through gt_index - 1: All values lte to the pivot.
-    // gt_index through pivot_index - 1: All values gt to the pivot.
-    // The pivot belongs with the gt section, so swap it there now.
-    values[pivot_index] = values[gt_index];
-    values[gt_index] = pivot;
-    // Recursion time.  Call ourselves for the left and right sides of the array.
-    if(gt_index - min_index > 1) {
-        quicksort_recursive(min_index, gt_index - 1, values);
+    return low;
+}
+
+
+// values[0..sorted) is already in order.
+static void ua_binary_insertion_sort(UA_Merge_Sort* sort, Value* values, int64_t count, int64_t sorted) {
+    for(int64_t i = sorted; i < count; i++) {
+        Value value = values[i];
+        int64_t target = ua_upper_bound(sort, values, i, value);
+        memmove(&values[target + 1], &values[target], (i - target) * sizeof(Value));
+        values[target] = value;
+    }
+}
+
+
+// The length of the run starting at values[0], made ascending if it wasn't.
+// Only strictly descending runs are reversed, or equal elements would swap.
+static int64_t ua_count_run(UA_Merge_Sort* sort, Value* values, int64_t count) {
+    if(count < 2) {
+        return count;
+    }
+    int64_t length = 2;
+    if(sort->less(sort, values[1], values[0])) {
+        while(length < count && sort->less(sort, values[length], values[length - 1])) {
+            length++;
+        }
+        for(int64_t low = 0, high = length - 1; low < high; low++, high--) {
+            Value swap = values[low];
+            values[low] = values[high];
+            values[high] = swap;
+        }
+    } else {
+        while(length < count && !sort->less(sort, values[length], values[length - 1])) {
+            length++;
+        }
+    }
+    return length;
+}
+
+
+// Between UA_MIN_MERGE / 2 and UA_MIN_MERGE, chosen so that count / min_run
+// is a power of two or just under one, which keeps the final merges balanced.
+static int64_t ua_min_run(int64_t count) {
+    int64_t remainder = 0;
+    while(count >= UA_MIN_MERGE) {
+        remainder |= count & 1;
+        count >>= 1;
+    }
+    return count + remainder;
+}
+
+
+// Merges run i with run i + 1 on the run stack.
+static void ua_merge_at(UA_Merge_Sort* sort, Value* values, int64_t i) {
+    Value* left = values + sort->run_base[i];
+    int64_t left_count = sort->run_length[i];
+    Value* right = values + sort->run_base[i + 1];
+    int64_t right_count = sort->run_length[i + 1];
+
+    sort->run_length[i] = left_count + right_count;
+    if(i == sort->run_count - 3) {
+        sort->run_base[i + 1] = sort->run_base[i + 2];
+        sort->run_length[i + 1] = sort->run_length[i + 2];
+    }
+    sort->run_count--;
+
+    // Whatever in the left run belongs before the first element of the right
+    // run is already in place, and so is whatever in the right run belongs
+    // after the last element of the left run.
+    int64_t skip = ua_upper_bound(sort, left, left_count, right[0]);
+    left += skip;
+    left_count -= skip;
+    if(left_count == 0) {
+        return;
+    }
+    right_count = ua_lower_bound(sort, right, right_count, left[left_count - 1]);
+    if(right_count == 0) {
+        return;
     }
-    if(max_index - gt_index > 1) {
-        quicksort_recursive(gt_index, max_index, values);
+
+    // Merge forwards out of a copy of the left run.  The right run is only ever
+    // read ahead of where the output is being written.
+    memcpy(sort->scratch, left, left_count * sizeof(Value));
+    Value* out = left;
+    Value* from_left = sort->scratch;
+    Value* left_end = sort->scratch + left_count;
+    Value* from_right = right;
+    Value* right_end = right + right_count;
+    while(from_left < left_end && from_right < right_end) {
+        // Ties go to the left run, which keeps the sort stable.
+        if(sort->less(sort, *from_right, *from_left)) {
+            *out++ = *from_right++;
+        } else {
+            *out++ = *from_left++;
+        }
     }
+    memcpy(out, from_left, (left_end - from_left) * sizeof(Value));
 }
 
 
-static void quicksort_recursive_callback(int min_index, int max_index, Value* values, Value callback) {
-    int pivot_index = max_index;
-    int gt_index = min_index;
-    Value pivot = values[pivot_index];
-    for(int i = min_index; i < pivot_index; i++) {
-        Value specimen = values[i];
-
-        Value callback_args[2] = { pivot, specimen };
-        Value sort_result = callCallback(callback, 2, callback_args);
-        // If we get a non-number result back, nothing really changes here.
-        // We're partitioning here based only if the specimen is gt, not lte,
-        // and we'll treat any less-than-1 value as lte.
-        if(IS_NUMBER(sort_result) && AS_NUMBER(sort_result) < 1) {
-            values[i] = values[gt_index];
-            values[gt_index] = specimen;
-            gt_index++;
+// Keeps run lengths on the stack shrinking faster than the Fibonacci numbers,
+// so merges stay balanced and the stack stays short.
+static void ua_merge_collapse(UA_Merge_Sort* sort, Value* values) {
+    while(sort->run_count > 1) {
+        int64_t n = sort->run_count - 2;
+        int64_t* length = sort->run_length;
+        if((n > 0 && length[n - 1] <= length[n] + length[n + 1]) ||
+           (n > 1 && length[n - 2] <= length[n - 1] + length[n])) {
+            if(length[n - 1] < length[n + 1]) {
+                n--;
+            }
+        } else if(length[n] > length[n + 1]) {
+            break;
         }
+        ua_merge_at(sort, values, n);
     }
-    values[pivot_index] = values[gt_index];
-    values[gt_index] = pivot;
-    if(gt_index - min_index > 1) {
-        quicksort_recursive_callback(min_index, gt_index - 1, values, callback);
+}
+
+
+static void ua_merge_sort(UA_Merge_Sort* sort, Value* values, int64_t count) {
+    sort->run_count = 0;
+    sort->frame_count = vm.frameCount;
+    sort->failed = false;
+    if(count < 2) {
+        return;
     }
-    if(max_index - gt_index > 1) {
-        quicksort_recursive_callback(gt_index, max_index, values, callback);
+
+    sort->scratch = ALLOCATE(Value, count);
+    int64_t min_run = ua_min_run(count);
+    int64_t base = 0;
+    while(base < count) {
+        int64_t remaining = count - base;
+        int64_t length = ua_count_run(sort, values + base, remaining);
+        if(length < min_run) {
+            int64_t forced = remaining < min_run ? remaining : min_run;
+            ua_binary_insertion_sort(sort, values + base, forced, length);
+            length = forced;
+        }
+        sort->run_base[sort->run_count] = base;
+        sort->run_length[sort->run_count] = length;
+        sort->run_count++;
+        ua_merge_collapse(sort, values);
+        base += length;
+    }
+    while(sort->run_count > 1) {
+        int64_t n = sort->run_count - 2;
+        if(n > 0 && sort->run_length[n - 1] < sort->run_length[n + 1]) {
+            n--;
+        }
+        ua_merge_at(sort, values, n);
     }
+    FREE_ARRAY(Value, sort->scratch, count);
 }
 
 
 /**
  * ar_sort(array)
- * - returns nil on parameter error
+ * - raises an error if the arguments are the wrong number or type
  * - returns a copy of the original array with the elements sorted
  */
 Value cc_function_ar_sort(int arg_count, Value* args) {
-    if(arg_count != 1) { return FERROR_VAL(FE_ARG_COUNT_1); }
-    if(!IS_USERARRAY(args[0])) { return FERROR_VAL(FE_ARG_1_ARRAY); }
-
     ObjUserArray* ua = AS_USERARRAY(args[0]);
     ObjUserArray* target_array = newUserArray();
     ua_grow(target_array, ua->inner.count);
 
-    for(int i = 0; i < ua->inner.count; i++) {
+    for(int64_t i = 0; i < ua->inner.count; i++) {
         target_array->inner.values[i] = ua->inner.values[i];
         target_array->inner.count++;
     }
 
-    quicksort_recursive(0, target_array->inner.count - 1, target_array->inner.values);
+    ua_sort_values(target_array->inner.values, target_array->inner.count);
 
     return OBJ_VAL(target_array);
 }
@@ -1015,7 +1557,7 @@ Value cc_function_ar_sort(int arg_count, Value* args) {
 
 /**
  * ar_sort_callback(array, callback)
- * - returns nil on parameter error
+ * - raises an error if the arguments are the wrong number or type
  * - returns a copy of the original array with the elements sorted using the
  *   given callback function to compare elements.
  *
@@ -1025,50 +1567,99 @@ Value cc_function_ar_sort(int arg_count, Value* args) {
  *   if zero was returned instead.
  */
 Value cc_function_ar_sort_callback(int arg_count, Value* args) {
-    if(arg_count != 2) { return FERROR_VAL(FE_ARG_COUNT_2); }
-    if(!IS_USERARRAY(args[0])) { return FERROR_VAL(FE_ARG_1_ARRAY); }
-    if(!IS_FUNCTION(args[1])) { return FERROR_VAL(FE_ARG_2_FUNCTION); }
+    ObjUserArray* ua = AS_USERARRAY(args[0]);
+    ObjUserArray* target_array = newUserArray();
+    ua_grow(target_array, ua->inner.count);
+
+    for(int64_t i = 0; i < ua->inner.count; i++) {
+        target_array->inner.values[i] = ua->inner.values[i];
+        target_array->inner.count++;
+    }
+
+    UA_Merge_Sort sort;
+    sort.less = ua_callback_less;
+    sort.callback = args[1];
+    ua_merge_sort(&sort, target_array->inner.values, target_array->inner.count);
+    if(sort.failed) {
+        return NIL_VAL;
+    }
 
+    return OBJ_VAL(target_array);
+}
+
+
+/**
+ * ar_sort_by(array, callback)
+ * - raises an error if the arguments are the wrong number or type
+ * - returns a copy of the original array sorted by the key the callback
+ *   returns for each element, in the same order ar_sort would put the keys.
+ *   The callback runs once per element, and elements with equal keys keep
+ *   their original order.
+ *
+ * => callback(value, index)
+ * - returns the key to sort the element by
+ */
+Value cc_function_ar_sort_by(int arg_count, Value* args) {
     ObjUserArray* ua = AS_USERARRAY(args[0]);
     ObjUserArray* target_array = newUserArray();
     ua_grow(target_array, ua->inner.count);
 
-    for(int i = 0; i < ua->inner.count; i++) {
+    for(int64_t i = 0; i < ua->inner.count; i++) {
         target_array->inner.values[i] = ua->inner.values[i];
         target_array->inner.count++;
     }
 
-    quicksort_recursive_callback(
-        0, target_array->inner.count - 1,
-        target_array->inner.values,
-        args[1]
-    );
+    // The callback works from the copy, in case it changes the original.
+    int64_t count = target_array->inner.count;
+    Value* values = target_array->inner.values;
+    Value* keys = ALLOCATE(Value, count);
+    Value* order = ALLOCATE(Value, count);
+    int64_t frame_count = vm.frameCount;
+    for(int64_t i = 0; i < count; i++) {
+        Value callback_args[2] = { values[i], NUMBER_VAL(i) };
+        keys[i] = callCallback(args[1], 2, callback_args);
+        if(vm.frameCount < frame_count) {
+            FREE_ARRAY(Value, keys, count);
+            FREE_ARRAY(Value, order, count);
+            return NIL_VAL;
+        }
+        order[i] = NUMBER_VAL(i);
+    }
 
+    UA_Merge_Sort sort;
+    sort.less = ua_key_less;
+    sort.keys = keys;
+    ua_merge_sort(&sort, order, count);
+
+    // The keys are done with, so they can hold the sorted values on the way.
+    for(int64_t i = 0; i < count; i++) {
+        keys[i] = values[(int64_t)AS_NUMBER(order[i])];
+    }
+    memcpy(values, keys, count * sizeof(Value));
+
+    FREE_ARRAY(Value, keys, count);
+    FREE_ARRAY(Value, order, count);
     return OBJ_VAL(target_array);
 }
 
 
 /**
  * ar_join(array, glue_string)
- * - returns nil on parameter error
+ * - raises an error if the arguments are the wrong number or type
  * - returns false if a non-string, non-nil element is in the array
  *   @FIXME ugh, need a way to force-stringify things
  * - returns a string of all array elements joined together with the glue string
  */
 Value cc_function_ar_join(int arg_count, Value* args) {
-    if(arg_count != 2) { return FERROR_VAL(FE_ARG_COUNT_2); }
-    if(!IS_USERARRAY(args[0])) { return FERROR_VAL(FE_ARG_1_ARRAY); }
-    if(!IS_STRING(args[1])) { return FERROR_VAL(FE_ARG_2_STRING); }
-
     ObjUserArray* ua = AS_USERARRAY(args[0]);
     ObjString* glue = AS_STRING(args[1]);
 
-    int new_string_length = (ua->inner.count - 1) * glue->length;
+    int64_t new_string_length = (ua->inner.count - 1) * glue->length;
     if(new_string_length < 0) {
         // We can end up negative if the array is empty.  Let's not.
         new_string_length = 0;
     }
-    for(int i = 0; i < ua->inner.count; i++) {
+    for(int64_t i = 0; i < ua->inner.count; i++) {
         // We can only join together things that are strings, but we'll be nice
         // and skip nils.  If there's anything we can process, bail now.
         if(!IS_NIL(ua->inner.values[i]) && !IS_STRING(ua->inner.values[i])) {
@@ -1081,8 +1672,8 @@ Value cc_function_ar_join(int arg_count, Value* args) {
     }
 
     char* new_string = ALLOCATE(char, new_string_length + 1);
-    int new_string_index = 0;
-    for(int i = 0; i < ua->inner.count; i++) {
+    int64_t new_string_index = 0;
+    for(int64_t i = 0; i < ua->inner.count; i++) {
         // If we're here, we know that all elements in the array are either
         // strings or nil.  Nil becomes the empty string, so we can ignore it.
         if(IS_STRING(ua->inner.values[i])) {
@@ -1105,7 +1696,7 @@ Value cc_function_ar_join(int arg_count, Value* args) {
 
 /**
  * ar_filter(array, callback)
- * - returns nil on parameter error
+ * - raises an error if the arguments are the wrong number or type
  * - returns a copy of the array filtered using the provided callback.
  *
  * => callback(value, index)
@@ -1113,22 +1704,22 @@ Value cc_function_ar_join(int arg_count, Value* args) {
  * - returns non-true otherwise
  */
 Value cc_function_ar_filter(int arg_count, Value* args) {
-    if(arg_count != 2) { return FERROR_VAL(FE_ARG_COUNT_2); }
-    if(!IS_USERARRAY(args[0])) { return FERROR_VAL(FE_ARG_1_ARRAY); }
-    if(!IS_FUNCTION(args[1])) { return FERROR_VAL(FE_ARG_2_FUNCTION); }
-
     ObjUserArray* ua = AS_USERARRAY(args[0]);
     ObjFunction* callback = AS_FUNCTION(args[1]);
 
     ObjUserArray* new_ua = newUserArray();
     ua_grow(new_ua, ua->inner.count);
 
-    for(int i = 0; i < ua->inner.count; i++) {
+    int64_t frame_count = vm.frameCount;
+    for(int64_t i = 0; i < ua->inner.count; i++) {
         Value callback_args[2] = {
             ua->inner.values[i],
             NUMBER_VAL(i)
         };
         Value res = callCallback(OBJ_VAL(callback), 2, callback_args);
+        if(vm.frameCount < frame_count) {
+            return NIL_VAL;
+        }
         if(IS_BOOL(res) && AS_BOOL(res) == true) {
             new_ua->inner.values[ new_ua->inner.count++ ] = ua->inner.values[i];
         }
@@ -1139,29 +1730,29 @@ Value cc_function_ar_filter(int arg_count, Value* args) {
 
 /**
  * ar_map(array, callback)
- * - returns nil on parameter error
+ * - raises an error if the arguments are the wrong number or type
  * - returns a copy of the array with each elemnt processed by the provided callback
  *
  * => callback(value, index)
  * - returns the new value that should be placed at the offset
  */
 Value cc_function_ar_map(int arg_count, Value* args) {
-    if(arg_count != 2) { return FERROR_VAL(FE_ARG_COUNT_2); }
-    if(!IS_USERARRAY(args[0])) { return FERROR_VAL(FE_ARG_1_ARRAY); }
-    if(!IS_FUNCTION(args[1])) { return FERROR_VAL(FE_ARG_2_FUNCTION); }
-
     ObjUserArray* ua = AS_USERARRAY(args[0]);
     ObjFunction* callback = AS_FUNCTION(args[1]);
 
     ObjUserArray* new_ua = newUserArray();
     ua_grow(new_ua, ua->inner.count);
 
-    for(int i = 0; i < ua->inner.count; i++) {
+    int64_t frame_count = vm.frameCount;
+    for(int64_t i = 0; i < ua->inner.count; i++) {
         Value callback_args[2] = {
             ua->inner.values[i],
             NUMBER_VAL(i)
         };
         Value res = callCallback(OBJ_VAL(callback), 2, callback_args);
+        if(vm.frameCount < frame_count) {
+            return NIL_VAL;
+        }
         new_ua->inner.values[ new_ua->inner.count++ ] = res;
     }
     return OBJ_VAL(new_ua);
@@ -1170,7 +1761,7 @@ Value cc_function_ar_map(int arg_count, Value* args) {
 
 /**
  * ar_reduce(array, callback)
- * - returns nil on parameter error
+ * - raises an error if the arguments are the wrong number or type
  * - returns a single value, the last returned by the callback
  *
  * => callback(accumulator, value, index)
@@ -1178,21 +1769,21 @@ Value cc_function_ar_map(int arg_count, Value* args) {
  *   the user if this is the last index.
  */
 Value cc_function_ar_reduce(int arg_count, Value* args) {
-    if(arg_count != 2) { return FERROR_VAL(FE_ARG_COUNT_2); }
-    if(!IS_USERARRAY(args[0])) { return FERROR_VAL(FE_ARG_1_ARRAY); }
-    if(!IS_FUNCTION(args[1])) { return FERROR_VAL(FE_ARG_2_FUNCTION); }
-
     ObjUserArray* ua = AS_USERARRAY(args[0]);
     ObjFunction* callback = AS_FUNCTION(args[1]);
 
     Value accumulator = NIL_VAL;
-    for(int i = 0; i < ua->inner.count; i++) {
+    int64_t frame_count = vm.frameCount;
+    for(int64_t i = 0; i < ua->inner.count; i++) {
         Value callback_args[3] = {
             accumulator,
             ua->inner.values[i],
             NUMBER_VAL(i)
         };
         accumulator = callCallback(OBJ_VAL(callback), 3, callback_args);
+        if(vm.frameCount < frame_count) {
+            return NIL_VAL;
+        }
     }
     return accumulator;
 }
@@ -1202,39 +1793,40 @@ void cc_register_ext_userarray() {
 
     defineNative("ar_create",     cc_function_ar_create);
 
-    defineNative("ar_set",        cc_function_ar_set);
-    defineNative("ar_update",     cc_function_ar_update);
-    defineNative("ar_has",        cc_function_ar_has);
-    defineNative("ar_get",        cc_function_ar_get);
-    defineNative("ar_remove",     cc_function_ar_remove);
-    defineNative("ar_count",      cc_function_ar_count);
-    defineNative("ar_clear",      cc_function_ar_clear);
+    defineNativeSignature("ar_set",    cc_function_ar_set,    3, 3, "an*");
+    defineNativeSignature("ar_update", cc_function_ar_update, 3, 3, "an*");
+    defineNativeSignature("ar_has",    cc_function_ar_has,    2, 2, "an");
+    defineNativeSignature("ar_get",    cc_function_ar_get,    2, 2, "an");
+    defineNativeSignature("ar_remove", cc_function_ar_remove, 2, 3, "ann");
+    defineNativeSignature("ar_count",  cc_function_ar_count,  1, 1, "a");
+    defineNativeSignature("ar_clear",  cc_function_ar_clear,  1, 1, "a");
 
-    defineNative("ar_push",       cc_function_ar_push);
-    defineNative("ar_unshift",    cc_function_ar_unshift);
-    defineNative("ar_pop",        cc_function_ar_pop);
-    defineNative("ar_shift",      cc_function_ar_shift);
+    defineNativeSignature("ar_push",    cc_function_ar_push,    2, 2, "a*");
+    defineNativeSignature("ar_unshift", cc_function_ar_unshift, 2, 2, "a*");
+    defineNativeSignature("ar_pop",     cc_function_ar_pop,     1, 1, "a");
+    defineNativeSignature("ar_shift",   cc_function_ar_shift,   1, 1, "a");
 
-    defineNative("ar_clone",      cc_function_ar_clone);
+    defineNativeSignature("ar_clone", cc_function_ar_clone, 1, 1, "a");
 
-    defineNative("ar_find",       cc_function_ar_find);
+    defineNativeSignature("ar_find", cc_function_ar_find, 2, 3, "a*n");
 
-    defineNative("ar_chunk",      cc_function_ar_chunk);
-    defineNative("ar_shuffle",    cc_function_ar_shuffle);
-    defineNative("ar_reverse",    cc_function_ar_reverse);
+    defineNativeSignature("ar_chunk",   cc_function_ar_chunk,   2, 2, "an");
+    defineNativeSignature("ar_shuffle", cc_function_ar_shuffle, 1, 1, "a");
+    defineNativeSignature("ar_reverse", cc_function_ar_reverse, 1, 1, "a");
 
-    defineNative("ar_slice",      cc_function_ar_slice);
-    defineNative("ar_insert",     cc_function_ar_insert);
-    defineNative("ar_append",     cc_function_ar_append);
-    defineNative("ar_prepend",    cc_function_ar_prepend);
+    defineNativeSignature("ar_slice",   cc_function_ar_slice,   2, 3, "ann");
+    defineNativeSignature("ar_insert",  cc_function_ar_insert,  3, 3, "ana");
+    defineNativeSignature("ar_append",  cc_function_ar_append,  2, 2, "aa");
+    defineNativeSignature("ar_prepend", cc_function_ar_prepend, 2, 2, "aa");
 
-    defineNative("ar_sort",       cc_function_ar_sort);
-    defineNative("ar_sort_callback", cc_function_ar_sort_callback);
+    defineNativeSignature("ar_sort",          cc_function_ar_sort,          1, 1, "a");
+    defineNativeSignature("ar_sort_callback", cc_function_ar_sort_callback, 2, 2, "ac");
+    defineNativeSignature("ar_sort_by",       cc_function_ar_sort_by,       2, 2, "ac");
 
-    defineNative("ar_join",       cc_function_ar_join);
+    defineNativeSignature("ar_join", cc_function_ar_join, 2, 2, "as");
 
-    defineNative("ar_filter",     cc_function_ar_filter);
-    defineNative("ar_map",        cc_function_ar_map);
-    defineNative("ar_reduce",     cc_function_ar_reduce);
+    defineNativeSignature("ar_filter", cc_function_ar_filter, 2, 2, "ac");
+    defineNativeSignature("ar_map",    cc_function_ar_map,    2, 2, "ac");
+    defineNativeSignature("ar_reduce", cc_function_ar_reduce, 2, 2, "ac");
 
 }
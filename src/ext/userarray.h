@@ -3,7 +3,12 @@
 
 #include "../object.h"
 
-void ua_grow(ObjUserArray* ua, int new_capacity);
+void ua_grow(ObjUserArray* ua, int64_t new_capacity);
+Value cc_function_ar_get(int arg_count, Value* args);
+Value cc_function_ar_set(int arg_count, Value* args);
+Value cc_function_ar_push(int arg_count, Value* args);
+Value cc_function_ar_sort(int arg_count, Value* args);
+Value cc_function_ar_join(int arg_count, Value* args);
 void cc_register_ext_userarray();
 
 #endif
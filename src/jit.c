@@ -0,0 +1,487 @@
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "common.h"
+#include "jit.h"
+#include "memory.h"
+
+#ifdef CC_JIT
+
+// Compiled code is entered with the frame in rdi and the address to start at
+// in rsi.  It keeps the frame in rbx, &vm.stackTop in r12 and the frame's
+// slots in r13, all callee-saved, and returns a JitStatus in eax.
+typedef int (*JitEntry)(CallFrame* frame, uint8_t* start);
+
+struct JitCode {
+  uint8_t* code;
+  size_t size;
+  // Offset into code for each bytecode offset that starts an instruction.
+  uint32_t* offsets;
+  int offsetCount;
+};
+
+// No instruction's template is longer than this, so a chunk of n bytes never
+// needs more than n * JIT_MAX_BYTES bytes of machine code plus the prologue.
+#define JIT_MAX_BYTES 128
+#define JIT_PROLOGUE_BYTES 64
+
+typedef struct {
+  uint8_t* code;
+  size_t count;
+} Assembler;
+
+typedef struct {
+  size_t at;        // Where the rel32 to patch lives.
+  int target;       // The bytecode offset it should land on.
+} JumpFixup;
+
+
+static void emitByte(Assembler* as, uint8_t byte) {
+  as->code[as->count++] = byte;
+}
+
+
+static void emitBytes(Assembler* as, const uint8_t* bytes, size_t length) {
+  memcpy(as->code + as->count, bytes, length);
+  as->count += length;
+}
+
+
+static void emit32(Assembler* as, uint32_t value) {
+  memcpy(as->code + as->count, &value, sizeof(value));
+  as->count += sizeof(value);
+}
+
+
+static void emit64(Assembler* as, uint64_t value) {
+  memcpy(as->code + as->count, &value, sizeof(value));
+  as->count += sizeof(value);
+}
+
+
+static void patchRel32(Assembler* as, size_t at, size_t target) {
+  int32_t rel = (int32_t)((int64_t)target - (int64_t)(at + 4));
+  memcpy(as->code + at, &rel, sizeof(rel));
+}
+
+
+static void emitPrologue(Assembler* as) {
+  static const uint8_t save[] = {
+    0x53,                     // push rbx
+    0x41, 0x54,               // push r12
+    0x41, 0x55,               // push r13
+    0x48, 0x89, 0xfb,         // mov rbx, rdi
+  };
+  emitBytes(as, save, sizeof(save));
+
+  emitBytes(as, (const uint8_t[]){ 0x49, 0xbc }, 2);   // mov r12, &vm.stackTop
+  emit64(as, (uint64_t)(uintptr_t)&vm.stackTop);
+
+  emitBytes(as, (const uint8_t[]){ 0x4c, 0x8b, 0xab }, 3);   // mov r13, [rbx + slots]
+  emit32(as, (uint32_t)offsetof(CallFrame, slots));
+
+  emitBytes(as, (const uint8_t[]){ 0xff, 0xe6 }, 2);   // jmp rsi
+}
+
+
+static void emitEpilogue(Assembler* as) {
+  static const uint8_t restore[] = {
+    0x41, 0x5d,               // pop r13
+    0x41, 0x5c,               // pop r12
+    0x5b,                     // pop rbx
+    0xc3,                     // ret
+  };
+  emitBytes(as, restore, sizeof(restore));
+}
+
+
+// helper(frame, ip), leaving its result in eax.
+static void emitHelperCall(Assembler* as, JitHelper helper, uint8_t* ip) {
+  emitBytes(as, (const uint8_t[]){ 0x48, 0x89, 0xdf }, 3);   // mov rdi, rbx
+  emitBytes(as, (const uint8_t[]){ 0x48, 0xbe }, 2);         // mov rsi, imm64
+  emit64(as, (uint64_t)(uintptr_t)ip);
+  emitBytes(as, (const uint8_t[]){ 0x48, 0xb8 }, 2);         // mov rax, imm64
+  emit64(as, (uint64_t)(uintptr_t)helper);
+  emitBytes(as, (const uint8_t[]){ 0xff, 0xd0 }, 2);         // call rax
+}
+
+
+// test eax, eax; jnz rel32.  Returns where the rel32 lives.
+static size_t emitJumpIfNonZero(Assembler* as) {
+  emitBytes(as, (const uint8_t[]){ 0x85, 0xc0, 0x0f, 0x85 }, 4);
+  size_t at = as->count;
+  emit32(as, 0);
+  return at;
+}
+
+
+// jmp rel32.  Returns where the rel32 lives.
+static size_t emitJump(Assembler* as) {
+  emitByte(as, 0xe9);
+  size_t at = as->count;
+  emit32(as, 0);
+  return at;
+}
+
+
+// Calls a helper that can end the compiled code's run, bailing out to the
+// epilogue with its status if it does.
+static void emitCheckedHelperCall(Assembler* as, JitHelper helper, uint8_t* ip,
+                                  size_t epilogue) {
+  emitHelperCall(as, helper, ip);
+  patchRel32(as, emitJumpIfNonZero(as), epilogue);
+}
+
+
+static void emitPushFromRax(Assembler* as) {
+  static const uint8_t push[] = {
+    0xf3, 0x0f, 0x6f, 0x00,         // movdqu xmm0, [rax]
+    0x49, 0x8b, 0x0c, 0x24,         // mov rcx, [r12]
+    0xf3, 0x0f, 0x7f, 0x01,         // movdqu [rcx], xmm0
+    0x49, 0x83, 0x04, 0x24,         // add qword [r12], sizeof(Value)
+    (uint8_t)sizeof(Value),
+  };
+  emitBytes(as, push, sizeof(push));
+}
+
+
+static void emitConstant(Assembler* as, Value* constant) {
+  emitBytes(as, (const uint8_t[]){ 0x48, 0xb8 }, 2);   // mov rax, imm64
+  emit64(as, (uint64_t)(uintptr_t)constant);
+  emitPushFromRax(as);
+}
+
+
+static void emitGetLocal(Assembler* as, uint8_t slot) {
+  emitBytes(as, (const uint8_t[]){ 0x49, 0x8d, 0x85 }, 3);   // lea rax, [r13 + disp32]
+  emit32(as, (uint32_t)(slot * sizeof(Value)));
+  emitPushFromRax(as);
+}
+
+
+static void emitSetLocal(Assembler* as, uint8_t slot) {
+  static const uint8_t peek[] = {
+    0x49, 0x8b, 0x0c, 0x24,         // mov rcx, [r12]
+    0xf3, 0x0f, 0x6f, 0x41,         // movdqu xmm0, [rcx - sizeof(Value)]
+    (uint8_t)-(int)sizeof(Value),
+  };
+  emitBytes(as, peek, sizeof(peek));
+  emitBytes(as, (const uint8_t[]){ 0xf3, 0x41, 0x0f, 0x7f, 0x85 }, 5);   // movdqu [r13 + disp32], xmm0
+  emit32(as, (uint32_t)(slot * sizeof(Value)));
+}
+
+
+static void emitPop(Assembler* as) {
+  static const uint8_t pop[] = {
+    0x49, 0x83, 0x2c, 0x24,         // sub qword [r12], sizeof(Value)
+    (uint8_t)sizeof(Value),
+  };
+  emitBytes(as, pop, sizeof(pop));
+}
+
+
+// Guards an inline fast path on both operands of a binary instruction being
+// numbers, leaving the stack top in rcx.  Returns where the rel32s of the two
+// jumps to the slow path live.
+static void emitNumberGuard(Assembler* as, size_t slowJumps[2]) {
+  emitBytes(as, (const uint8_t[]){ 0x49, 0x8b, 0x0c, 0x24 }, 4);   // mov rcx, [r12]
+  emitBytes(as, (const uint8_t[]){ 0x83, 0x79, 0xf0, VAL_NUMBER, 0x0f, 0x85 }, 6);   // cmp dword [rcx - 16], VAL_NUMBER; jne
+  slowJumps[0] = as->count;
+  emit32(as, 0);
+  emitBytes(as, (const uint8_t[]){ 0x83, 0x79, 0xe0, VAL_NUMBER, 0x0f, 0x85 }, 6);   // cmp dword [rcx - 32], VAL_NUMBER; jne
+  slowJumps[1] = as->count;
+  emit32(as, 0);
+}
+
+
+// Finishes a binary instruction's fast path by dropping the right operand and
+// skipping the helper call that follows for the slow path.
+static void emitBinaryTail(Assembler* as, JitHelper helper, uint8_t* ip,
+                           size_t slowJumps[2], size_t epilogue) {
+  emitPop(as);
+  size_t done = emitJump(as);
+  patchRel32(as, slowJumps[0], as->count);
+  patchRel32(as, slowJumps[1], as->count);
+  emitCheckedHelperCall(as, helper, ip, epilogue);
+  patchRel32(as, done, as->count);
+}
+
+
+// a = a <op> b for two numbers inline, where op is the second byte of the SSE2
+// scalar double instruction (addsd, subsd, mulsd or divsd).
+static void emitArithmetic(Assembler* as, uint8_t sseOp, JitHelper helper,
+                           uint8_t* ip, size_t epilogue) {
+  size_t slowJumps[2];
+  emitNumberGuard(as, slowJumps);
+  emitBytes(as, (const uint8_t[]){ 0xf2, 0x0f, 0x10, 0x41, 0xe8 }, 5);    // movsd xmm0, [rcx - 24]
+  emitBytes(as, (const uint8_t[]){ 0xf2, 0x0f, sseOp, 0x41, 0xf8 }, 5);   // <op>sd xmm0, [rcx - 8]
+  emitBytes(as, (const uint8_t[]){ 0xf2, 0x0f, 0x11, 0x41, 0xe8 }, 5);    // movsd [rcx - 24], xmm0
+  emitBinaryTail(as, helper, ip, slowJumps, epilogue);
+}
+
+
+// a = a > b (or a < b when swapped) for two numbers inline.  ucomisd leaves
+// the flags "unordered" for NaN, which seta reads as false, like C does.
+static void emitComparison(Assembler* as, bool swapped, JitHelper helper,
+                           uint8_t* ip, size_t epilogue) {
+  uint8_t left = swapped ? 0xf8 : 0xe8;
+  uint8_t right = swapped ? 0xe8 : 0xf8;
+  size_t slowJumps[2];
+  emitNumberGuard(as, slowJumps);
+  emitBytes(as, (const uint8_t[]){ 0xf2, 0x0f, 0x10, 0x41, left }, 5);    // movsd xmm0, [rcx + left]
+  emitBytes(as, (const uint8_t[]){ 0x66, 0x0f, 0x2e, 0x41, right }, 5);   // ucomisd xmm0, [rcx + right]
+  static const uint8_t store[] = {
+    0x0f, 0x97, 0xc0,                       // seta al
+    0x0f, 0xb6, 0xc0,                       // movzx eax, al
+    0x48, 0x89, 0x41, 0xe8,                 // mov [rcx - 24], rax
+    0xc7, 0x41, 0xe0, VAL_BOOL, 0, 0, 0,    // mov dword [rcx - 32], VAL_BOOL
+  };
+  emitBytes(as, store, sizeof(store));
+  emitBinaryTail(as, helper, ip, slowJumps, epilogue);
+}
+
+
+// Jumps if the value on top of the stack is nil or false, without popping it.
+// Returns where the rel32s of the two jumps live.
+static void emitJumpIfFalsey(Assembler* as, size_t jumps[2]) {
+  static const uint8_t checkNil[] = {
+    0x49, 0x8b, 0x0c, 0x24,           // mov rcx, [r12]
+    0x8b, 0x41, 0xf0,                 // mov eax, [rcx - 16]
+    0x83, 0xf8, VAL_NIL,              // cmp eax, VAL_NIL
+    0x0f, 0x84,                       // je
+  };
+  emitBytes(as, checkNil, sizeof(checkNil));
+  jumps[0] = as->count;
+  emit32(as, 0);
+  static const uint8_t checkFalse[] = {
+    0x83, 0xf8, VAL_BOOL,             // cmp eax, VAL_BOOL
+    0x75, 0x0a,                       // jne past the next two instructions
+    0x80, 0x79, 0xf8, 0x00,           // cmp byte [rcx - 8], 0
+    0x0f, 0x84,                       // je
+  };
+  emitBytes(as, checkFalse, sizeof(checkFalse));
+  jumps[1] = as->count;
+  emit32(as, 0);
+}
+
+
+static void* allocateCode(size_t size) {
+  void* code = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  return code == MAP_FAILED ? NULL : code;
+}
+
+
+static bool compileChunk(ObjFunction* function, struct JitCode* jit,
+                         JumpFixup* fixups) {
+  Chunk* chunk = &function->chunk;
+  Assembler as = { jit->code, 0 };
+  int fixupCount = 0;
+
+  emitPrologue(&as);
+  size_t epilogue = as.count;
+  emitEpilogue(&as);
+
+  int offset = 0;
+  while (offset < chunk->count) {
+    uint8_t* code = chunk->code + offset;
+    uint8_t instruction = code[0];
+    jit->offsets[offset] = (uint32_t)as.count;
+
+    // The number of bytes in the instruction, operands included.
+    int length = 1;
+    // Set for jumps, to the bytecode offset they land on.
+    int target = -1;
+    // Set for helpers that can't end the run, to skip the status check.
+    JitHelper plain = NULL;
+    // Set for helpers that can.
+    JitHelper checked = NULL;
+
+    switch (instruction) {
+      case OP_CONSTANT:
+        length = 2;
+        emitConstant(&as, &chunk->constants.values[code[1]]);
+        break;
+
+      case OP_NIL:   plain = jitOpNil; break;
+      case OP_TRUE:  plain = jitOpTrue; break;
+      case OP_FALSE: plain = jitOpFalse; break;
+
+      case OP_POP:
+#ifdef CC_FEATURES
+      case OP_TRANSCLUDE:
+#endif
+        emitPop(&as);
+        break;
+
+      case OP_GET_LOCAL:
+        length = 2;
+        emitGetLocal(&as, code[1]);
+        break;
+
+      case OP_SET_LOCAL:
+        length = 2;
+        emitSetLocal(&as, code[1]);
+        break;
+
+      case OP_GET_GLOBAL:    length = 2; checked = jitOpGetGlobal; break;
+      case OP_DEFINE_GLOBAL: length = 2; plain = jitOpDefineGlobal; break;
+      case OP_SET_GLOBAL:    length = 2; checked = jitOpSetGlobal; break;
+
+      case OP_EQUAL: plain = jitOpEqual; break;
+
+      // Numbers are handled inline, with the helper as the slow path for
+      // strings and errors.  The interpreter's number-only variants compile
+      // the same way as the generic instructions.
+      case OP_GREATER:
+      case OP_GREATER_NUM:
+        emitComparison(&as, false, jitOpGreater, code + length, epilogue);
+        break;
+      case OP_LESS:
+      case OP_LESS_NUM:
+        emitComparison(&as, true, jitOpLess, code + length, epilogue);
+        break;
+      case OP_ADD:
+      case OP_ADD_NUM:
+        emitArithmetic(&as, 0x58, jitOpAdd, code + length, epilogue);
+        break;
+      case OP_SUBTRACT:
+      case OP_SUBTRACT_NUM:
+        emitArithmetic(&as, 0x5c, jitOpSubtract, code + length, epilogue);
+        break;
+      case OP_MULTIPLY:
+      case OP_MULTIPLY_NUM:
+        emitArithmetic(&as, 0x59, jitOpMultiply, code + length, epilogue);
+        break;
+      case OP_DIVIDE:
+      case OP_DIVIDE_NUM:
+        emitArithmetic(&as, 0x5e, jitOpDivide, code + length, epilogue);
+        break;
+
+      case OP_NOT:    plain = jitOpNot; break;
+      case OP_NEGATE: checked = jitOpNegate; break;
+      case OP_PRINT:  plain = jitOpPrint; break;
+
+      case OP_JUMP:
+        length = 3;
+        target = offset + 3 + (uint16_t)((code[1] << 8) | code[2]);
+        fixups[fixupCount].at = emitJump(&as);
+        fixups[fixupCount++].target = target;
+        break;
+
+      case OP_JUMP_IF_FALSE: {
+        length = 3;
+        target = offset + 3 + (uint16_t)((code[1] << 8) | code[2]);
+        size_t jumps[2];
+        emitJumpIfFalsey(&as, jumps);
+        fixups[fixupCount].at = jumps[0];
+        fixups[fixupCount++].target = target;
+        fixups[fixupCount].at = jumps[1];
+        fixups[fixupCount++].target = target;
+        break;
+      }
+
+      case OP_LOOP:
+        length = 3;
+        target = offset + 3 - (uint16_t)((code[1] << 8) | code[2]);
+        fixups[fixupCount].at = emitJump(&as);
+        fixups[fixupCount++].target = target;
+        break;
+
+      case OP_CALL:      length = 2; checked = jitOpCall; break;
+      case OP_TAIL_CALL: length = 2; checked = jitOpTailCall; break;
+      case OP_RETURN:    checked = jitOpReturn; break;
+
+#ifdef CC_FEATURES
+      case OP_EXIT: checked = jitOpExit; break;
+      case OP_ECHO: length = 2; plain = jitOpEcho; break;
+
+      case OP_ARRAY_GET:
+      case OP_ARRAY_SET:
+      case OP_ARRAY_COUNT:
+      case OP_ARRAY_PUSH:
+      case OP_HASH_GET:
+        length = 3;
+        checked = jitOpIntrinsic;
+        break;
+#endif
+
+      default:
+        // Something we don't know how to compile.  Leave it to run().
+        return false;
+    }
+
+    if (plain != NULL) {
+      emitHelperCall(&as, plain, code + length);
+    } else if (checked != NULL) {
+      emitCheckedHelperCall(&as, checked, code + length, epilogue);
+    }
+
+    offset += length;
+  }
+
+  for (int i = 0; i < fixupCount; i++) {
+    if (fixups[i].target < 0 || fixups[i].target >= chunk->count ||
+        jit->offsets[fixups[i].target] == UINT32_MAX) {
+      return false;
+    }
+    patchRel32(&as, fixups[i].at, jit->offsets[fixups[i].target]);
+  }
+  return true;
+}
+
+
+bool jitCompile(ObjFunction* function) {
+  // The inline templates move Values around as one 16 byte SSE load/store.
+  if (sizeof(Value) != 16 || function->chunk.count == 0) {
+    function->jitFailed = true;
+    return false;
+  }
+
+  struct JitCode* jit = ALLOCATE(struct JitCode, 1);
+  jit->size = JIT_PROLOGUE_BYTES + (size_t)function->chunk.count * JIT_MAX_BYTES;
+  jit->offsetCount = function->chunk.count;
+  jit->offsets = ALLOCATE(uint32_t, jit->offsetCount);
+  jit->code = allocateCode(jit->size);
+  // Anything left at this marker doesn't start an instruction.
+  memset(jit->offsets, 0xff, sizeof(uint32_t) * jit->offsetCount);
+  // At most two jumps per instruction.
+  JumpFixup* fixups = ALLOCATE(JumpFixup, function->chunk.count * 2);
+
+  bool compiled = jit->code != NULL && compileChunk(function, jit, fixups) &&
+                  mprotect(jit->code, jit->size, PROT_READ | PROT_EXEC) == 0;
+  FREE_ARRAY(JumpFixup, fixups, function->chunk.count * 2);
+
+  if (!compiled) {
+    if (jit->code != NULL) munmap(jit->code, jit->size);
+    FREE_ARRAY(uint32_t, jit->offsets, jit->offsetCount);
+    FREE(struct JitCode, jit);
+    function->jitFailed = true;
+    return false;
+  }
+
+  function->jitCode = jit;
+  return true;
+}
+
+
+JitStatus jitEnter(CallFrame* frame) {
+  struct JitCode* jit = frame->function->jitCode;
+  size_t offset = (size_t)(frame->ip - frame->function->chunk.code);
+  JitEntry entry = (JitEntry)(uintptr_t)jit->code;
+  return (JitStatus)entry(frame, jit->code + jit->offsets[offset]);
+}
+
+
+void jitFreeFunction(ObjFunction* function) {
+  struct JitCode* jit = function->jitCode;
+  if (jit == NULL) return;
+
+  munmap(jit->code, jit->size);
+  FREE_ARRAY(uint32_t, jit->offsets, jit->offsetCount);
+  FREE(struct JitCode, jit);
+  function->jitCode = NULL;
+}
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef clox_jit_h
+#define clox_jit_h
+
+#include "common.h"
+#include "object.h"
+#include "profiler.h"
+#include "vm.h"
+
+#ifdef CC_JIT
+
+// A baseline JIT for x86-64 Linux, turned on by building with -DCC_JIT.
+//
+// Once a function has been called or has looped back JIT_THRESHOLD times, its
+// chunk is translated into machine code that calls one of the jitOp helpers in
+// vm.c per instruction, with jumps, the plain stack shuffles (constants,
+// locals, pops) and arithmetic and comparisons on numbers done inline.
+// Nothing is kept in registers from one instruction to the next, so the
+// interpreter can hand a frame over to the compiled code at any instruction
+// boundary.  That's how loops in the top level script get compiled too.
+// Functions using an opcode the JIT doesn't know stay interpreted.
+
+#ifndef JIT_THRESHOLD
+#define JIT_THRESHOLD 1000
+#endif
+
+typedef enum {
+  JIT_CONTINUE,   // Helpers only: carry on with the next instruction.
+  JIT_ERROR,      // A runtime error has been reported.
+  JIT_RETURNED,   // The frame returned, leaving its result for the caller.
+  JIT_REPLACED    // A tail call started a new function in the same frame.
+} JitStatus;
+
+typedef int (*JitHelper)(CallFrame* frame, uint8_t* ip);
+
+bool jitCompile(ObjFunction* function);
+JitStatus jitEnter(CallFrame* frame);
+void jitFreeFunction(ObjFunction* function);
+
+
+// True when the function has compiled code to run.  Visits (calls and loop
+// back-edges) count towards compiling it.
+static inline bool jitReady(ObjFunction* function, bool countVisit) {
+  if (function->jitCode != NULL) return true;
+  // Compiled code doesn't keep frame->ip up to date for the profiler.
+  if (!countVisit || function->jitFailed || profilerEnabled) return false;
+  if (++function->hotness < JIT_THRESHOLD) return false;
+  return jitCompile(function);
+}
+
+
+// Instruction helpers, in vm.c.  ip points just past the instruction, so any
+// operands sit right behind it.
+int jitOpNil(CallFrame* frame, uint8_t* ip);
+int jitOpTrue(CallFrame* frame, uint8_t* ip);
+int jitOpFalse(CallFrame* frame, uint8_t* ip);
+int jitOpGetGlobal(CallFrame* frame, uint8_t* ip);
+int jitOpDefineGlobal(CallFrame* frame, uint8_t* ip);
+int jitOpSetGlobal(CallFrame* frame, uint8_t* ip);
+int jitOpEqual(CallFrame* frame, uint8_t* ip);
+int jitOpGreater(CallFrame* frame, uint8_t* ip);
+int jitOpLess(CallFrame* frame, uint8_t* ip);
+int jitOpAdd(CallFrame* frame, uint8_t* ip);
+int jitOpSubtract(CallFrame* frame, uint8_t* ip);
+int jitOpMultiply(CallFrame* frame, uint8_t* ip);
+int jitOpDivide(CallFrame* frame, uint8_t* ip);
+int jitOpNot(CallFrame* frame, uint8_t* ip);
+int jitOpNegate(CallFrame* frame, uint8_t* ip);
+int jitOpPrint(CallFrame* frame, uint8_t* ip);
+int jitOpCall(CallFrame* frame, uint8_t* ip);
+int jitOpTailCall(CallFrame* frame, uint8_t* ip);
+int jitOpReturn(CallFrame* frame, uint8_t* ip);
+int jitOpExit(CallFrame* frame, uint8_t* ip);
+int jitOpEcho(CallFrame* frame, uint8_t* ip);
+int jitOpIntrinsic(CallFrame* frame, uint8_t* ip);
+
+#endif
+
+#endif
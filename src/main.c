@@ -5,6 +5,9 @@
 #include "common.h"
 #include "chunk.h"
 #include "debug.h"
+#include "memory.h"
+#include "profiler.h"
+#include "stats.h"
 #include "vm.h"
 
 
@@ -65,6 +68,8 @@ static void runFile(const char* path) {
   InterpretResult result = interpret(source, 1);
   free(source);
 
+  // freeVM() writes out any profiles and reports before we bail.
+  if (result != INTERPRET_OK) freeVM();
   if (result == INTERPRET_COMPILE_ERROR) exit(65);
   if (result == INTERPRET_RUNTIME_ERROR) exit(70);
 }
@@ -73,6 +78,38 @@ static void runFile(const char* path) {
 int main(int argc, const char* argv[]) {
   initVM();
 
+#ifdef CC_FEATURES
+  // Options come before the path and are hidden from the script, which sees
+  // the usual argv.
+  //   --profile[=file]  sample the script, writing collapsed stacks to the file
+  //   --memory-report   print allocation counters at exit
+  const char* profileOutput = NULL;
+  while (argc >= 2 && strncmp(argv[1], "--", 2) == 0) {
+    if (strcmp(argv[1], "--profile") == 0) {
+      profileOutput = PROFILER_DEFAULT_OUTPUT;
+    } else if (strncmp(argv[1], "--profile=", 10) == 0) {
+      profileOutput = argv[1] + 10;
+    } else if (strcmp(argv[1], "--memory-report") == 0) {
+      memoryReportAtExit = true;
+    } else {
+      fprintf(stderr, "Unknown option \"%s\".\n", argv[1]);
+      exit(64);
+    }
+    argc--;
+    argv++;
+  }
+
+  if (profileOutput != NULL) {
+    if (argc < 2) {
+      fprintf(stderr, "Usage: clox --profile[=file] path\n");
+      exit(64);
+    }
+    if (!profilerStart(profileOutput)) {
+      exit(74);
+    }
+  }
+#endif
+
   extern int global_argc;
   extern const char** global_argv;
   global_argc = argc;
@@ -83,7 +120,7 @@ int main(int argc, const char* argv[]) {
   } else if (argc >= 2) {
     runFile(argv[1]);
   } else {
-    fprintf(stderr, "Usage: clox [path]\n");
+    fprintf(stderr, "Usage: clox [--profile[=file]] [--memory-report] [path]\n");
     exit(64);
   }
 
@@ -1,10 +1,37 @@
+#include <stdio.h>
 #include <stdlib.h>
 
 #include "common.h"
 #include "memory.h"
 #include "vm.h"
 
+#ifdef CC_JIT
+#include "jit.h"
+#endif
+
+MemoryStats memoryStats;
+bool memoryReportAtExit = false;
+
+
+static void trackUsage(MemoryUsage* usage, size_t oldSize, size_t newSize) {
+  usage->live += newSize - oldSize;
+  if (usage->live > usage->peak) usage->peak = usage->live;
+}
+
+
 void* reallocate(void* previous, size_t oldSize, size_t newSize) {
+  return reallocateAs(MEM_OTHER, previous, oldSize, newSize);
+}
+
+
+// The counters trust oldSize, so freeing with a different size than was
+// allocated throws them off.
+void* reallocateAs(MemoryCategory category, void* previous, size_t oldSize, size_t newSize) {
+  trackUsage(&memoryStats.total, oldSize, newSize);
+  trackUsage(&memoryStats.categories[category], oldSize, newSize);
+  if (previous == NULL) memoryStats.allocations++;
+  if (newSize > oldSize) memoryStats.bytesAllocated += newSize - oldSize;
+
   if (newSize == 0) {
     free(previous);
     return NULL;
@@ -14,48 +41,125 @@ void* reallocate(void* previous, size_t oldSize, size_t newSize) {
 }
 
 
+void* allocateObjectMemory(size_t size, ObjType type) {
+  trackUsage(&memoryStats.objects[type], 0, size);
+  memoryStats.objectCounts[type]++;
+  return reallocateAs(MEM_OBJECT, NULL, 0, size);
+}
+
+
+#define FREE_OBJ(objType, object) \
+    do { \
+      trackUsage(&memoryStats.objects[(object)->type], sizeof(objType), 0); \
+      memoryStats.objectCounts[(object)->type]--; \
+      reallocateAs(MEM_OBJECT, object, sizeof(objType), 0); \
+    } while (false)
+
+
+const char* memoryCategoryName(MemoryCategory category) {
+  switch (category) {
+    case MEM_CHUNK:       return "chunks";
+    case MEM_TABLE:       return "tables";
+    case MEM_VALUE_ARRAY: return "value_arrays";
+    case MEM_STRING:      return "strings";
+    case MEM_OBJECT:      return "objects";
+    case MEM_OTHER:       return "other";
+    default:              return "unknown";
+  }
+}
+
+
+const char* objTypeName(ObjType type) {
+  switch (type) {
+    case OBJ_FUNCTION:    return "function";
+    case OBJ_NATIVE:      return "native";
+    case OBJ_STRING:      return "string";
+#ifdef CC_FEATURES
+    case OBJ_USERHASH:    return "userhash";
+    case OBJ_USERARRAY:   return "userarray";
+    case OBJ_FILEHANDLE:  return "filehandle";
+    case OBJ_FILEMAP:     return "filemap";
+    case OBJ_FERROR:      return "ferror";
+#endif
+    default:              return "unknown";
+  }
+}
+
+
+// Live bytes are whatever hasn't been freed by the time this runs, which is
+// right before freeVM() frees everything.
+void printMemoryReport() {
+  fprintf(stderr, "Memory: %zu bytes live, %zu peak, %zu allocated in %zu allocations\n",
+          memoryStats.total.live, memoryStats.total.peak,
+          memoryStats.bytesAllocated, memoryStats.allocations);
+
+  fprintf(stderr, "\n  %-14s %12s %12s\n", "category", "live", "peak");
+  for (int i = 0; i < MEM_CATEGORY_COUNT; i++) {
+    fprintf(stderr, "  %-14s %12zu %12zu\n", memoryCategoryName(i),
+            memoryStats.categories[i].live, memoryStats.categories[i].peak);
+  }
+
+  fprintf(stderr, "\n  %-14s %12s %12s %12s\n", "object", "count", "live", "peak");
+  for (int i = 0; i < OBJ_TYPE_COUNT; i++) {
+    fprintf(stderr, "  %-14s %12zu %12zu %12zu\n", objTypeName(i),
+            memoryStats.objectCounts[i], memoryStats.objects[i].live,
+            memoryStats.objects[i].peak);
+  }
+}
+
+
 static void freeObject(Obj* object) {
   switch (object->type) {
 
     case OBJ_FUNCTION: {
       ObjFunction* function = (ObjFunction*)object;
+#ifdef CC_JIT
+      jitFreeFunction(function);
+#endif
       freeChunk(&function->chunk);
-      FREE(ObjFunction, object);
+      FREE_OBJ(ObjFunction, object);
       break;
     }
 
     case OBJ_NATIVE:
-      FREE(ObjNative, object);
+      FREE_OBJ(ObjNative, object);
       break;
 
     case OBJ_STRING: {
       ObjString* string = (ObjString*)object;
       FREE_ARRAY(char, string->chars, string->length + 1);
-      FREE(ObjString, object);
+      FREE_OBJ(ObjString, object);
       break;
     }
 
     case OBJ_USERARRAY: {
       ObjUserArray* ua = (ObjUserArray*)object;
-      freeValueArray(&ua->inner);
-      FREE(ObjUserArray, object);
+      FREE_ARRAY(Value, ua->inner.values - ua->front, ua->front + ua->inner.capacity);
+      FREE_OBJ(ObjUserArray, object);
       break;
     }
 
     case OBJ_USERHASH: {
       ObjUserHash* ht = (ObjUserHash*)object;
       freeTable(&ht->table);
-      FREE(ObjUserHash, object);
+      FREE_OBJ(ObjUserHash, object);
       break;
     }
 
     case OBJ_FILEHANDLE: {
-      FREE(ObjFileHandle, object);
+      free(((ObjFileHandle*)object)->line_buffer);
+      FREE_OBJ(ObjFileHandle, object);
+      break;
+    }
+
+    case OBJ_FILEMAP: {
+      releaseFileMap((ObjFileMap*)object);
+      FREE_OBJ(ObjFileMap, object);
       break;
     }
 
     case OBJ_FERROR: {
-      FREE(ObjFunctionError, object);
+      FREE_OBJ(ObjFunctionError, object);
       break;
     }
 
@@ -3,23 +3,68 @@
 
 #include "object.h"
 
+// Every allocation is counted against one of these, picked from the type being
+// allocated by MEMORY_CATEGORY().  Object headers are counted as MEM_OBJECT
+// and broken down further by ObjType.  Character buffers are all strings,
+// whether or not they end up inside an ObjString.
+typedef enum {
+  MEM_CHUNK,          // Bytecode and line numbers.
+  MEM_TABLE,          // Hash table entries: globals, interned strings, hashes.
+  MEM_VALUE_ARRAY,    // Constant pools and user arrays.
+  MEM_STRING,
+  MEM_OBJECT,
+  MEM_OTHER,
+  MEM_CATEGORY_COUNT
+} MemoryCategory;
+
+typedef struct {
+  size_t live;
+  size_t peak;
+} MemoryUsage;
+
+typedef struct {
+  MemoryUsage total;
+  MemoryUsage categories[MEM_CATEGORY_COUNT];
+  MemoryUsage objects[OBJ_TYPE_COUNT];
+  size_t objectCounts[OBJ_TYPE_COUNT];
+  size_t allocations;
+  size_t bytesAllocated;    // Every byte ever asked for, freed or not.
+} MemoryStats;
+
+extern MemoryStats memoryStats;
+extern bool memoryReportAtExit;
+
+#define MEMORY_CATEGORY(type) \
+    _Generic((type*)NULL, \
+        uint8_t*: MEM_CHUNK, \
+        int*: MEM_CHUNK, \
+        Entry*: MEM_TABLE, \
+        Value*: MEM_VALUE_ARRAY, \
+        char*: MEM_STRING, \
+        default: MEM_OTHER)
+
 #define ALLOCATE(type, count) \
-    (type*)reallocate(NULL, 0, sizeof(type) * (count))
+    (type*)reallocateAs(MEMORY_CATEGORY(type), NULL, 0, sizeof(type) * (count))
 
 #define FREE(type, pointer) \
-    reallocate(pointer, sizeof(type), 0)
+    reallocateAs(MEMORY_CATEGORY(type), pointer, sizeof(type), 0)
 
 #define GROW_CAPACITY(capacity) \
     ((capacity) < 8 ? 8 : (capacity) * 2)
 
 #define GROW_ARRAY(previous, type, oldCount, count) \
-    (type*)reallocate(previous, sizeof(type) * (oldCount), \
-        sizeof(type) * (count))
+    (type*)reallocateAs(MEMORY_CATEGORY(type), previous, \
+        sizeof(type) * (oldCount), sizeof(type) * (count))
 
 #define FREE_ARRAY(type, pointer, oldCount) \
-    reallocate(pointer, sizeof(type) * (oldCount), 0)
+    reallocateAs(MEMORY_CATEGORY(type), pointer, sizeof(type) * (oldCount), 0)
 
 void* reallocate(void* previous, size_t oldSize, size_t newSize);
+void* reallocateAs(MemoryCategory category, void* previous, size_t oldSize, size_t newSize);
+void* allocateObjectMemory(size_t size, ObjType type);
+const char* memoryCategoryName(MemoryCategory category);
+const char* objTypeName(ObjType type);
+void printMemoryReport();
 void freeObjects();
 
 #endif
@@ -2,6 +2,7 @@
 #include <string.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <sys/mman.h>
 
 #include "memory.h"
 #include "object.h"
@@ -14,7 +15,7 @@
 
 
 static Obj* allocateObject(size_t size, ObjType type) {
-  Obj* object = (Obj*)reallocate(NULL, 0, size);
+  Obj* object = (Obj*)allocateObjectMemory(size, type);
   object->type = type;
 
   object->next = vm.objects;
@@ -36,6 +37,7 @@ ObjUserArray* newUserArray() {
   ObjUserArray* array = ALLOCATE_OBJ(ObjUserArray, OBJ_USERARRAY);
 
   initValueArray(&array->inner);
+  array->front = 0;
   return array;
 }
 
@@ -55,13 +57,44 @@ ObjFileHandle* newFileHandle(FILE* handle) {
   fh->is_writer = false;
   fh->is_open = false;
 
+  fh->line_buffer = NULL;
+  fh->line_buffer_size = 0;
+
   return fh;
 }
 
+ObjFileMap* newFileMap(FileMapping* mapping, const char* start, int64_t length) {
+  ObjFileMap* view = ALLOCATE_OBJ(ObjFileMap, OBJ_FILEMAP);
+
+  view->mapping = mapping;
+  view->start = start;
+  view->length = length;
+  mapping->views++;
+  return view;
+}
+
+
+// Returns false if the view had already been released.
+bool releaseFileMap(ObjFileMap* view) {
+  FileMapping* mapping = view->mapping;
+  if (mapping == NULL) return false;
+
+  view->mapping = NULL;
+  view->start = NULL;
+  view->length = 0;
+  if (--mapping->views == 0) {
+    if (mapping->size > 0) munmap(mapping->base, mapping->size);
+    FREE(FileMapping, mapping);
+  }
+  return true;
+}
+
+
 ObjFunctionError* newFunctionError(int ferror_id, int sys_errno) {
   ObjFunctionError* e = ALLOCATE_OBJ(ObjFunctionError, OBJ_FERROR);
   e->ferror_id = ferror_id;
   e->sys_errno = sys_errno;
+  e->detail = NULL;
   return e;
 }
 
@@ -73,6 +106,11 @@ ObjFunction* newFunction() {
   function->arity = 0;
   function->name = NULL;
   initChunk(&function->chunk);
+#ifdef CC_JIT
+  function->hotness = 0;
+  function->jitFailed = false;
+  function->jitCode = NULL;
+#endif
   return function;
 }
 
@@ -81,27 +119,36 @@ ObjNative* newNative(NativeFn function, ObjString* name) {
   ObjNative* native = ALLOCATE_OBJ(ObjNative, OBJ_NATIVE);
   native->function = function;
   native->name = name;
+  native->minArity = 0;
+  native->maxArity = NATIVE_VARIADIC;
+  native->argTypes = NULL;
+#ifdef DEBUG_OPCODE_STATS
+  native->statsCalls = 0;
+  native->statsNanos = 0;
+#endif
   return native;
 }
 
 
-static ObjString* allocateString(char* chars, int length, uint32_t hash) {
+static ObjString* allocateString(char* chars, int64_t length, uint32_t hash,
+                                 bool interned) {
   ObjString* string = ALLOCATE_OBJ(ObjString, OBJ_STRING);
   string->length = length;
   string->chars = chars;
   string->hash = hash;
+  string->interned = interned;
 
-  tableSet(&vm.strings, string, NIL_VAL);
+  if (interned) tableSet(&vm.strings, string, NIL_VAL);
 
   return string;
 }
 
 
 // 32-bit FNV-1a.  The magic numbers are predefined.  See Wikipedia.
-static uint32_t hashString(const char* key, int length) {
+static uint32_t hashString(const char* key, int64_t length) {
   uint32_t hash = 2166136261u;
 
-  for (int i = 0; i < length; i++) {
+  for (int64_t i = 0; i < length; i++) {
     hash ^= key[i];
     hash *= 16777619;
   }
@@ -110,8 +157,9 @@ static uint32_t hashString(const char* key, int length) {
 }
 
 
-ObjString* takeString(char* chars, int length) {
+ObjString* takeString(char* chars, int64_t length) {
   uint32_t hash = hashString(chars, length);
+  if (length >= STRING_INTERN_MAX) return allocateString(chars, length, hash, false);
 
   ObjString* interned = tableFindString(&vm.strings, chars, length, hash);
   if (interned != NULL) {
@@ -119,11 +167,12 @@ ObjString* takeString(char* chars, int length) {
     return interned;
   }
 
-  return allocateString(chars, length, hash);
+  return allocateString(chars, length, hash, true);
 }
 
 
-ObjString* copyString(const char* chars, int length) {
+ObjString* copyString(const char* chars, int64_t length) {
+  if (length >= STRING_INTERN_MAX) return copyUninternedString(chars, length);
   uint32_t hash = hashString(chars, length);
 
   ObjString* interned = tableFindString(&vm.strings, chars, length, hash);
@@ -133,7 +182,45 @@ ObjString* copyString(const char* chars, int length) {
   memcpy(heapChars, chars, length);
   heapChars[length] = '\0';
 
-  return allocateString(heapChars, length, hash);
+  return allocateString(heapChars, length, hash, true);
+}
+
+
+// For strings that probably won't ever be compared or used as a key, like
+// lines read from a file.  They still get hashed, which valuesEqual() uses to
+// rule out most unequal pairs without looking at the characters.
+ObjString* takeUninternedString(char* chars, int64_t length) {
+  return allocateString(chars, length, hashString(chars, length), false);
+}
+
+
+ObjString* copyUninternedString(const char* chars, int64_t length) {
+  char* heapChars = ALLOCATE(char, length + 1);
+  memcpy(heapChars, chars, length);
+  heapChars[length] = '\0';
+
+  return takeUninternedString(heapChars, length);
+}
+
+
+// Returns the interned string equal to this one, which becomes it if there
+// wasn't one already.
+ObjString* internString(ObjString* string) {
+  if (string->interned) return string;
+
+  ObjString* interned = findInternedString(string);
+  if (interned != NULL) return interned;
+
+  string->interned = true;
+  tableSet(&vm.strings, string, NIL_VAL);
+  return string;
+}
+
+
+// Returns the interned string equal to this one, or NULL if there isn't one.
+ObjString* findInternedString(ObjString* string) {
+  if (string->interned) return string;
+  return tableFindString(&vm.strings, string->chars, string->length, string->hash);
 }
 
 
@@ -170,6 +257,14 @@ void printObject(Value value) {
       printf("<user array>");
       break;
 
+    case OBJ_FILEMAP:
+      if (AS_FILEMAP(value)->mapping == NULL) {
+        printf("<filemap released>");
+      } else {
+        printf("<filemap %lld bytes>", (long long)AS_FILEMAP(value)->length);
+      }
+      break;
+
     case OBJ_FILEHANDLE:
       printf("<filehandle #%d>", fileno(AS_FILEHANDLE(value)->handle));
       break;
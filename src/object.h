@@ -19,6 +19,7 @@
 #define IS_USERHASH(value)      isObjType(value, OBJ_USERHASH)
 #define IS_USERARRAY(value)     isObjType(value, OBJ_USERARRAY)
 #define IS_FILEHANDLE(value)    isObjType(value, OBJ_FILEHANDLE)
+#define IS_FILEMAP(value)       isObjType(value, OBJ_FILEMAP)
 #define IS_FERROR(value)        isObjType(value, OBJ_FERROR)
 #endif
 
@@ -31,6 +32,7 @@
 #define AS_USERHASH(value)      ((ObjUserHash*)AS_OBJ(value))
 #define AS_USERARRAY(value)     ((ObjUserArray*)AS_OBJ(value))
 #define AS_FILEHANDLE(value)    ((ObjFileHandle*)AS_OBJ(value))
+#define AS_FILEMAP(value)       ((ObjFileMap*)AS_OBJ(value))
 #define AS_FERROR(value)        ((ObjFunctionError*)AS_OBJ(value))
 #endif
 
@@ -42,10 +44,17 @@ typedef enum {
   OBJ_USERHASH,
   OBJ_USERARRAY,
   OBJ_FILEHANDLE,
+  OBJ_FILEMAP,
   OBJ_FERROR,
 #endif
 } ObjType;
 
+#ifdef CC_FEATURES
+#define OBJ_TYPE_COUNT (OBJ_FERROR + 1)
+#else
+#define OBJ_TYPE_COUNT (OBJ_STRING + 1)
+#endif
+
 
 struct sObj {
   ObjType type;
@@ -53,21 +62,43 @@ struct sObj {
 };
 
 
+#ifdef CC_JIT
+struct JitCode;
+#endif
+
 typedef struct {
   Obj obj;
   int arity;
   Chunk chunk;
   ObjString* name;
+#ifdef CC_JIT
+  int hotness;
+  bool jitFailed;
+  struct JitCode* jitCode;
+#endif
 } ObjFunction;
 
 
 typedef Value (*NativeFn)(int argCount, Value* args);
 
+#define NATIVE_VARIADIC -1
 
+// Natives can declare how many arguments they take and what each one must be,
+// which the VM checks before making the call.  argTypes holds one character
+// per argument: n(umber), s(tring), a(rray), h(ash), f(ilehandle),
+// m (file map), c(allable Lox function) or * (anything).  Arguments past the end of the
+// string aren't checked, and a NULL argTypes skips type checking entirely.
 typedef struct {
   Obj obj;
   NativeFn function;
   ObjString* name;
+  int minArity;
+  int maxArity;
+  const char* argTypes;
+#ifdef DEBUG_OPCODE_STATS
+  uint64_t statsCalls;
+  uint64_t statsNanos;
+#endif
 } ObjNative;
 
 #ifdef CC_FEATURES
@@ -77,9 +108,14 @@ typedef struct {
   Table table;
 } ObjUserHash;
 
+// inner.values points at the first element, which isn't necessarily the start
+// of the allocation: ar_shift() and ar_unshift() move the start of the array
+// instead of every element in it.  front is the number of free slots before
+// inner.values, and inner.capacity counts from inner.values on.
 typedef struct {
   Obj obj;
   ValueArray inner;
+  int64_t front;
 } ObjUserArray;
 
 typedef struct {
@@ -89,21 +125,53 @@ typedef struct {
   bool is_reader;
   bool is_writer;
   bool is_open;
+  // getline()'s buffer, kept between fh_read_line() calls and grown as needed.
+  // It comes from malloc(), not the VM's allocator.
+  char* line_buffer;
+  size_t line_buffer_size;
 } ObjFileHandle;
 
+// A read-only mmap() of a whole file, shared by every view into it.  The pages
+// are unmapped when the last view is released.
+typedef struct {
+  char* base;
+  size_t size;
+  int64_t views;
+} FileMapping;
+
+// A range of a mapped file.  Views read the mapped pages where they are
+// instead of copying them into strings, so they aren't NUL terminated.  A
+// released view has no mapping and can't be read any more.
+typedef struct {
+  Obj obj;
+  FileMapping* mapping;
+  const char* start;
+  int64_t length;
+} ObjFileMap;
+
 typedef struct {
   Obj obj;
   int ferror_id;
   int sys_errno;
+  // More about what went wrong, shown after the message, or NULL.
+  const char* detail;
 } ObjFunctionError;
 
 #endif
 
+// Strings are normally interned in vm.strings, so equal strings are the same
+// object.  Strings of STRING_INTERN_MAX bytes or more, and strings read from
+// files, usually aren't used as keys or compared, so they skip the intern
+// table and don't fill it up.  valuesEqual() compares their contents, and
+// tables intern them when they are used as keys.
+#define STRING_INTERN_MAX 128
+
 struct sObjString {
   Obj obj;
-  int length;
+  int64_t length;
   char* chars;
   uint32_t hash;
+  bool interned;
 };
 
 
@@ -111,12 +179,18 @@ struct sObjString {
 ObjUserHash* newUserHash();
 ObjUserArray* newUserArray();
 ObjFileHandle* newFileHandle(FILE* handle);
+ObjFileMap* newFileMap(FileMapping* mapping, const char* start, int64_t length);
+bool releaseFileMap(ObjFileMap* view);
 ObjFunctionError* newFunctionError(int ferror_id, int sys_errno);
 #endif
 ObjFunction* newFunction();
 ObjNative* newNative(NativeFn function, ObjString* name);
-ObjString* takeString(char* chars, int length);
-ObjString* copyString(const char* chars, int length);
+ObjString* takeString(char* chars, int64_t length);
+ObjString* copyString(const char* chars, int64_t length);
+ObjString* takeUninternedString(char* chars, int64_t length);
+ObjString* copyUninternedString(const char* chars, int64_t length);
+ObjString* internString(ObjString* string);
+ObjString* findInternedString(ObjString* string);
 
 
 void printObject(Value value);
@@ -0,0 +1,333 @@
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "common.h"
+#include "profiler.h"
+#include "vm.h"
+
+#ifdef CC_FEATURES
+
+volatile sig_atomic_t profilerPending = 0;
+bool profilerEnabled = false;
+
+// Samples are aggregated by the exact stack of functions, outermost first,
+// for the collapsed output, and by the function and line on top for the hot
+// list.  Both are open addressed hash tables that grow at 75% load.
+typedef struct {
+  uint32_t hash;
+  int depth;
+  ObjFunction** functions;
+  long samples;
+} StackEntry;
+
+typedef struct {
+  ObjFunction* function;
+  int line;
+  long samples;
+} LineEntry;
+
+typedef struct {
+  ObjFunction* function;
+  long self;
+  long total;
+} FunctionEntry;
+
+static FILE* output = NULL;
+static const char* outputName = NULL;
+static long totalSamples = 0;
+
+static StackEntry* stacks = NULL;
+static int stackCount = 0;
+static int stackCapacity = 0;
+
+static LineEntry* lines = NULL;
+static int lineCount = 0;
+static int lineCapacity = 0;
+
+
+static void handleProfilerTick(int signal) {
+  profilerPending++;
+}
+
+
+static uint32_t hashPointer(uint32_t hash, const void* pointer) {
+  uintptr_t bits = (uintptr_t)pointer;
+  for (size_t i = 0; i < sizeof(bits); i++) {
+    hash ^= (uint8_t)(bits >> (i * 8));
+    hash *= 16777619;
+  }
+  return hash;
+}
+
+
+static const char* functionName(ObjFunction* function) {
+  return function->name == NULL ? "script" : function->name->chars;
+}
+
+
+static StackEntry* findStack(StackEntry* entries, int capacity, uint32_t hash,
+                             ObjFunction** functions, int depth) {
+  uint32_t index = hash & (capacity - 1);
+  for (;;) {
+    StackEntry* entry = &entries[index];
+    if (entry->functions == NULL) return entry;
+    if (entry->hash == hash && entry->depth == depth &&
+        memcmp(entry->functions, functions, depth * sizeof(ObjFunction*)) == 0) {
+      return entry;
+    }
+    index = (index + 1) & (capacity - 1);
+  }
+}
+
+
+static void growStacks() {
+  int capacity = stackCapacity < 64 ? 64 : stackCapacity * 2;
+  StackEntry* entries = calloc(capacity, sizeof(StackEntry));
+  for (int i = 0; i < stackCapacity; i++) {
+    StackEntry* old = &stacks[i];
+    if (old->functions == NULL) continue;
+    *findStack(entries, capacity, old->hash, old->functions, old->depth) = *old;
+  }
+  free(stacks);
+  stacks = entries;
+  stackCapacity = capacity;
+}
+
+
+static LineEntry* findLine(LineEntry* entries, int capacity,
+                           ObjFunction* function, int line) {
+  uint32_t hash = hashPointer(2166136261u, function) ^ (uint32_t)line * 2654435761u;
+  uint32_t index = hash & (capacity - 1);
+  for (;;) {
+    LineEntry* entry = &entries[index];
+    if (entry->function == NULL) return entry;
+    if (entry->function == function && entry->line == line) return entry;
+    index = (index + 1) & (capacity - 1);
+  }
+}
+
+
+static void growLines() {
+  int capacity = lineCapacity < 64 ? 64 : lineCapacity * 2;
+  LineEntry* entries = calloc(capacity, sizeof(LineEntry));
+  for (int i = 0; i < lineCapacity; i++) {
+    LineEntry* old = &lines[i];
+    if (old->function == NULL) continue;
+    *findLine(entries, capacity, old->function, old->line) = *old;
+  }
+  free(lines);
+  lines = entries;
+  lineCapacity = capacity;
+}
+
+
+bool profilerStart(const char* outputPath) {
+  output = fopen(outputPath, "w");
+  if (output == NULL) {
+    fprintf(stderr, "Could not open profile output \"%s\": %s\n",
+            outputPath, strerror(errno));
+    return false;
+  }
+  outputName = outputPath;
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = handleProfilerTick;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+
+  struct itimerval timer;
+  timer.it_interval.tv_sec = 0;
+  timer.it_interval.tv_usec = PROFILER_INTERVAL_USEC;
+  timer.it_value = timer.it_interval;
+
+  if (sigaction(SIGPROF, &action, NULL) != 0 ||
+      setitimer(ITIMER_PROF, &timer, NULL) != 0) {
+    fprintf(stderr, "Could not start the profiler timer: %s\n", strerror(errno));
+    fclose(output);
+    output = NULL;
+    return false;
+  }
+
+  profilerEnabled = true;
+  return true;
+}
+
+
+// Called from run() with every frame's ip saved.  The top frame's ip points at
+// the instruction about to run, the others just past their call instruction.
+void profilerSample() {
+  long weight = profilerPending;
+  profilerPending -= weight;
+  if (!profilerEnabled || vm.frameCount == 0 || weight == 0) return;
+
+  ObjFunction* functions[FRAMES_MAX];
+  int depth = vm.frameCount;
+  uint32_t hash = 2166136261u;
+  for (int i = 0; i < depth; i++) {
+    functions[i] = vm.frames[i].function;
+    hash = hashPointer(hash, functions[i]);
+  }
+
+  if (stackCount + 1 > stackCapacity * 3 / 4) growStacks();
+  StackEntry* stack = findStack(stacks, stackCapacity, hash, functions, depth);
+  if (stack->functions == NULL) {
+    stack->hash = hash;
+    stack->depth = depth;
+    stack->functions = malloc(depth * sizeof(ObjFunction*));
+    memcpy(stack->functions, functions, depth * sizeof(ObjFunction*));
+    stackCount++;
+  }
+  stack->samples += weight;
+
+  CallFrame* frame = &vm.frames[depth - 1];
+  Chunk* chunk = &frame->function->chunk;
+  int offset = (int)(frame->ip - chunk->code);
+  if (offset >= chunk->count) offset = chunk->count - 1;
+  int line = chunk->lines[offset];
+
+  if (lineCount + 1 > lineCapacity * 3 / 4) growLines();
+  LineEntry* entry = findLine(lines, lineCapacity, frame->function, line);
+  if (entry->function == NULL) {
+    entry->function = frame->function;
+    entry->line = line;
+    lineCount++;
+  }
+  entry->samples += weight;
+
+  totalSamples += weight;
+}
+
+
+static int compareLines(const void* a, const void* b) {
+  long left = ((const LineEntry*)a)->samples;
+  long right = ((const LineEntry*)b)->samples;
+  return (left < right) - (left > right);
+}
+
+
+static int compareFunctions(const void* a, const void* b) {
+  long left = ((const FunctionEntry*)a)->self;
+  long right = ((const FunctionEntry*)b)->self;
+  if (left == right) {
+    left = ((const FunctionEntry*)a)->total;
+    right = ((const FunctionEntry*)b)->total;
+  }
+  return (left < right) - (left > right);
+}
+
+
+static FunctionEntry* findFunction(FunctionEntry* entries, int* count,
+                                   ObjFunction* function) {
+  for (int i = 0; i < *count; i++) {
+    if (entries[i].function == function) return &entries[i];
+  }
+  FunctionEntry* entry = &entries[(*count)++];
+  entry->function = function;
+  entry->self = 0;
+  entry->total = 0;
+  return entry;
+}
+
+
+static void writeCollapsedStacks() {
+  for (int i = 0; i < stackCapacity; i++) {
+    StackEntry* stack = &stacks[i];
+    if (stack->functions == NULL) continue;
+    for (int j = 0; j < stack->depth; j++) {
+      fprintf(output, j == 0 ? "%s" : ";%s", functionName(stack->functions[j]));
+    }
+    fprintf(output, " %ld\n", stack->samples);
+  }
+}
+
+
+static void printFunctionSummary() {
+  // Every function appears in some stack, so the number of distinct stacks
+  // times their depth bounds the number of functions.
+  int capacity = 0;
+  for (int i = 0; i < stackCapacity; i++) capacity += stacks[i].depth;
+  FunctionEntry* functions = malloc((capacity + 1) * sizeof(FunctionEntry));
+  int count = 0;
+
+  for (int i = 0; i < stackCapacity; i++) {
+    StackEntry* stack = &stacks[i];
+    if (stack->functions == NULL) continue;
+    findFunction(functions, &count, stack->functions[stack->depth - 1])->self +=
+        stack->samples;
+    for (int j = 0; j < stack->depth; j++) {
+      // Recursion shouldn't count the same samples twice towards the total.
+      bool seen = false;
+      for (int k = 0; k < j && !seen; k++) {
+        seen = stack->functions[k] == stack->functions[j];
+      }
+      if (!seen) {
+        findFunction(functions, &count, stack->functions[j])->total += stack->samples;
+      }
+    }
+  }
+
+  qsort(functions, count, sizeof(FunctionEntry), compareFunctions);
+  fprintf(stderr, "\n   self   total  function\n");
+  for (int i = 0; i < count && i < 15; i++) {
+    fprintf(stderr, "%6.1f%% %6.1f%%  %s\n",
+            100.0 * functions[i].self / totalSamples,
+            100.0 * functions[i].total / totalSamples,
+            functionName(functions[i].function));
+  }
+  free(functions);
+}
+
+
+static void printHotLines() {
+  LineEntry* sorted = malloc((lineCount + 1) * sizeof(LineEntry));
+  int count = 0;
+  for (int i = 0; i < lineCapacity; i++) {
+    if (lines[i].function != NULL) sorted[count++] = lines[i];
+  }
+
+  qsort(sorted, count, sizeof(LineEntry), compareLines);
+  fprintf(stderr, "\n   self  samples  line\n");
+  for (int i = 0; i < count && i < 20; i++) {
+    fprintf(stderr, "%6.1f%% %8ld  %d in %s\n",
+            100.0 * sorted[i].samples / totalSamples, sorted[i].samples,
+            sorted[i].line, functionName(sorted[i].function));
+  }
+  free(sorted);
+}
+
+
+// Stops the timer and writes the report.  This has to happen before freeVM()
+// frees the functions the samples point at.
+void profilerFinish() {
+  if (!profilerEnabled) return;
+  profilerEnabled = false;
+
+  struct itimerval timer;
+  memset(&timer, 0, sizeof(timer));
+  setitimer(ITIMER_PROF, &timer, NULL);
+
+  writeCollapsedStacks();
+  fclose(output);
+  output = NULL;
+
+  fprintf(stderr, "Profile: %ld samples every %dus, collapsed stacks written to %s\n",
+          totalSamples, PROFILER_INTERVAL_USEC, outputName);
+  if (totalSamples > 0) {
+    printFunctionSummary();
+    printHotLines();
+  }
+
+  for (int i = 0; i < stackCapacity; i++) free(stacks[i].functions);
+  free(stacks);
+  free(lines);
+  stacks = NULL;
+  lines = NULL;
+  stackCount = stackCapacity = lineCount = lineCapacity = 0;
+}
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef clox_profiler_h
+#define clox_profiler_h
+
+#include <signal.h>
+
+#include "common.h"
+
+#ifdef CC_FEATURES
+
+// A sampling profiler, turned on with --profile.
+//
+// A SIGPROF timer only bumps profilerPending.  The interpreter loop notices it
+// before its next instruction, saves its frame and calls profilerSample(), so
+// the frame stack is walked outside the signal handler with every frame's ip
+// up to date.  Time spent inside a native is charged to the instruction after
+// the call, which sits on the same line.
+
+#define PROFILER_INTERVAL_USEC 1000
+#define PROFILER_DEFAULT_OUTPUT "clox.folded"
+
+extern volatile sig_atomic_t profilerPending;
+extern bool profilerEnabled;
+
+bool profilerStart(const char* outputPath);
+void profilerSample();
+void profilerFinish();
+
+#endif
+
+#endif
@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "common.h"
+#include "debug.h"
+#include "object.h"
+#include "stats.h"
+#include "vm.h"
+
+#ifdef DEBUG_OPCODE_STATS
+
+uint64_t statsOpcodes[UINT8_COUNT];
+uint64_t statsPairs[UINT8_COUNT][UINT8_COUNT];
+int statsPrevious = -1;
+
+static bool dumped = false;
+
+typedef struct {
+  uint8_t first;
+  uint8_t second;
+  uint64_t count;
+} PairCount;
+
+
+uint64_t statsNow() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+
+static int comparePairs(const void* a, const void* b) {
+  uint64_t left = ((const PairCount*)a)->count;
+  uint64_t right = ((const PairCount*)b)->count;
+  return (left < right) - (left > right);
+}
+
+
+static int compareNatives(const void* a, const void* b) {
+  uint64_t left = (*(ObjNative* const*)a)->statsNanos;
+  uint64_t right = (*(ObjNative* const*)b)->statsNanos;
+  return (left < right) - (left > right);
+}
+
+
+static const char* nameOf(uint8_t instruction) {
+  const char* name = opcodeName(instruction);
+  return name == NULL ? "OP_UNKNOWN" : name;
+}
+
+
+static void writeOpcodes(FILE* out) {
+  uint64_t total = 0;
+  for (int i = 0; i < UINT8_COUNT; i++) total += statsOpcodes[i];
+  fprintf(out, "  \"instructions\": %llu,\n", (unsigned long long)total);
+
+  fprintf(out, "  \"opcodes\": {");
+  bool first = true;
+  for (int i = 0; i < UINT8_COUNT; i++) {
+    if (statsOpcodes[i] == 0) continue;
+    fprintf(out, "%s\n    \"%s\": %llu", first ? "" : ",",
+            nameOf(i), (unsigned long long)statsOpcodes[i]);
+    first = false;
+  }
+  fprintf(out, "\n  },\n");
+}
+
+
+// Most frequent first.
+static void writePairs(FILE* out) {
+  int count = 0;
+  for (int i = 0; i < UINT8_COUNT; i++) {
+    for (int j = 0; j < UINT8_COUNT; j++) {
+      if (statsPairs[i][j] != 0) count++;
+    }
+  }
+
+  PairCount* pairs = malloc((count + 1) * sizeof(PairCount));
+  count = 0;
+  for (int i = 0; i < UINT8_COUNT; i++) {
+    for (int j = 0; j < UINT8_COUNT; j++) {
+      if (statsPairs[i][j] == 0) continue;
+      pairs[count].first = (uint8_t)i;
+      pairs[count].second = (uint8_t)j;
+      pairs[count++].count = statsPairs[i][j];
+    }
+  }
+  qsort(pairs, count, sizeof(PairCount), comparePairs);
+
+  fprintf(out, "  \"pairs\": [");
+  for (int i = 0; i < count; i++) {
+    fprintf(out, "%s\n    [\"%s\", \"%s\", %llu]", i == 0 ? "" : ",",
+            nameOf(pairs[i].first), nameOf(pairs[i].second),
+            (unsigned long long)pairs[i].count);
+  }
+  fprintf(out, "\n  ],\n");
+  free(pairs);
+}
+
+
+// Most time spent first.  Natives are never freed before the VM is, so they
+// can be found by walking the object list.
+static void writeNatives(FILE* out) {
+  int count = 0;
+  for (Obj* object = vm.objects; object != NULL; object = object->next) {
+    if (object->type == OBJ_NATIVE && ((ObjNative*)object)->statsCalls > 0) count++;
+  }
+
+  ObjNative** natives = malloc((count + 1) * sizeof(ObjNative*));
+  count = 0;
+  for (Obj* object = vm.objects; object != NULL; object = object->next) {
+    if (object->type == OBJ_NATIVE && ((ObjNative*)object)->statsCalls > 0) {
+      natives[count++] = (ObjNative*)object;
+    }
+  }
+  qsort(natives, count, sizeof(ObjNative*), compareNatives);
+
+  fprintf(out, "  \"natives\": [");
+  for (int i = 0; i < count; i++) {
+    fprintf(out, "%s\n    {\"name\": \"%s\", \"calls\": %llu, \"seconds\": %.6f}",
+            i == 0 ? "" : ",", natives[i]->name->chars,
+            (unsigned long long)natives[i]->statsCalls,
+            natives[i]->statsNanos / 1e9);
+  }
+  fprintf(out, "\n  ]\n");
+  free(natives);
+}
+
+
+// Runs once, before freeVM() frees the natives.
+void statsDump() {
+  if (dumped) return;
+  dumped = true;
+
+  const char* path = getenv("CLOX_OPCODE_STATS");
+  if (path == NULL || path[0] == '\0') path = STATS_DEFAULT_OUTPUT;
+
+  FILE* out = fopen(path, "w");
+  if (out == NULL) {
+    fprintf(stderr, "Could not write opcode stats to \"%s\".\n", path);
+    return;
+  }
+
+  fprintf(out, "{\n");
+  writeOpcodes(out);
+  writePairs(out);
+  writeNatives(out);
+  fprintf(out, "}\n");
+  fclose(out);
+}
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef clox_stats_h
+#define clox_stats_h
+
+#include "common.h"
+
+#ifdef DEBUG_OPCODE_STATS
+
+// Execution counters for deciding what to optimize, built in with
+// -DDEBUG_OPCODE_STATS.  run() counts every instruction it dispatches and
+// every pair of consecutive instructions (candidates for superinstructions).
+// callValue() counts calls per native and the time spent in them, including
+// any Lox callbacks they make.  Intrinsic opcodes that don't fall back to a
+// native call only show up in the opcode counts.
+//
+// Everything is written as JSON at exit, to the file named by the
+// CLOX_OPCODE_STATS environment variable or STATS_DEFAULT_OUTPUT.
+
+#define STATS_DEFAULT_OUTPUT "clox.opstats.json"
+
+extern uint64_t statsOpcodes[UINT8_COUNT];
+extern uint64_t statsPairs[UINT8_COUNT][UINT8_COUNT];
+extern int statsPrevious;
+
+static inline void statsCountInstruction(uint8_t instruction) {
+  statsOpcodes[instruction]++;
+  if (statsPrevious >= 0) statsPairs[statsPrevious][instruction]++;
+  statsPrevious = instruction;
+}
+
+uint64_t statsNow();
+void statsDump();
+
+#endif
+
+#endif
@@ -59,8 +59,11 @@ static Entry* findEntry(Entry* entries, int capacity, ObjString* key) {
 }
 
 
+// Keys are always interned, so entries can be found by comparing pointers.  A
+// string that has no interned copy can't be a key in any table.
 bool tableGet(Table* table, ObjString* key, Value* value) {
   if (table->count == 0) return false;
+  if (!key->interned && (key = findInternedString(key)) == NULL) return false;
 
   Entry* entry = findEntry(table->entries, table->capacity, key);
   if (entry->key == NULL) return false;
@@ -95,6 +98,8 @@ static void adjustCapacity(Table* table, int capacity) {
 
 
 bool tableSet(Table* table, ObjString* key, Value value) {
+  key = internString(key);
+
   if (table->count + 1 > table->capacity * TABLE_MAX_LOAD) {
     int capacity = GROW_CAPACITY(table->capacity);
     adjustCapacity(table, capacity);
@@ -113,6 +118,7 @@ bool tableSet(Table* table, ObjString* key, Value value) {
 
 bool tableDelete(Table* table, ObjString* key) {
   if (table->count == 0) return false;
+  if (!key->interned && (key = findInternedString(key)) == NULL) return false;
 
   // Find the entry.
   Entry* entry = findEntry(table->entries, table->capacity, key);
@@ -140,7 +146,7 @@ void tableAddAll(Table* from, Table* to) {
 }
 
 
-ObjString* tableFindString(Table* table, const char* chars, int length, uint32_t hash) {
+ObjString* tableFindString(Table* table, const char* chars, int64_t length, uint32_t hash) {
   if (table->count == 0) return NULL;
 
   uint32_t index = hash % table->capacity;
@@ -27,7 +27,7 @@ bool tableGet(Table* table, ObjString* key, Value* value);
 bool tableSet(Table* table, ObjString* key, Value value);
 bool tableDelete(Table* table, ObjString* key);
 void tableAddAll(Table* from, Table* to);
-ObjString* tableFindString(Table* table, const char* chars, int length, uint32_t hash);
+ObjString* tableFindString(Table* table, const char* chars, int64_t length, uint32_t hash);
 
 
 #endif
@@ -15,7 +15,7 @@ void initValueArray(ValueArray* array) {
 
 void writeValueArray(ValueArray* array, Value value) {
   if (array->capacity < array->count + 1) {
-    int oldCapacity = array->capacity;
+    int64_t oldCapacity = array->capacity;
     array->capacity = GROW_CAPACITY(oldCapacity);
     array->values = GROW_ARRAY(array->values, Value,
                                oldCapacity, array->capacity);
@@ -57,6 +57,17 @@ bool valuesEqual(Value a, Value b) {
     case VAL_BOOL:   return AS_BOOL(a) == AS_BOOL(b);
     case VAL_NIL:    return true;
     case VAL_NUMBER: return AS_NUMBER(a) == AS_NUMBER(b);
-    case VAL_OBJ:    return AS_OBJ(a) == AS_OBJ(b);
+    case VAL_OBJ: {
+      if (AS_OBJ(a) == AS_OBJ(b)) return true;
+      if (!IS_STRING(a) || !IS_STRING(b)) return false;
+
+      // Two interned strings are only equal if they're the same string.  Any
+      // other pair has to be compared by what's in them.
+      ObjString* left = AS_STRING(a);
+      ObjString* right = AS_STRING(b);
+      if (left->interned && right->interned) return false;
+      return left->length == right->length && left->hash == right->hash &&
+             memcmp(left->chars, right->chars, left->length) == 0;
+    }
   }
 }
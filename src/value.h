@@ -44,8 +44,8 @@ typedef struct {
 
 
 typedef struct {
-  int capacity;
-  int count;
+  int64_t capacity;
+  int64_t count;
   Value* values;
 } ValueArray;
 
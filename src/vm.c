@@ -10,7 +10,10 @@
 #include "debug.h"
 #include "object.h"
 #include "memory.h"
+#include "profiler.h"
+#include "stats.h"
 #include "vm.h"
+#include "workers.h"
 
 #ifdef CC_FEATURES
 #include "ext/functions.h"
@@ -19,6 +22,10 @@
 #include "ext/ferrors.h"
 #endif
 
+#ifdef CC_JIT
+#include "jit.h"
+#endif
+
 VM vm;
 
 
@@ -57,18 +64,76 @@ static void runtimeError(const char* format, ...) {
   resetStack();
 }
 
-#ifdef CC_FEATURES
-void defineNative(const char* name, NativeFn function) {
-#else
-static void defineNative(const char* name, NativeFn function) {
-#endif
+static ObjNative* addNative(const char* name, NativeFn function) {
   ObjString* native_name = copyString(name, (int)strlen(name));
   push(OBJ_VAL(native_name));
-  push(OBJ_VAL(newNative(function, native_name)));
+  ObjNative* native = newNative(function, native_name);
+  push(OBJ_VAL(native));
   tableSet(&vm.globals, native_name, vm.stack[1]);
   pop();
   pop();
+  return native;
+}
+
+
+#ifdef CC_FEATURES
+void defineNative(const char* name, NativeFn function) {
+#else
+static void defineNative(const char* name, NativeFn function) {
+#endif
+  addNative(name, function);
+}
+
+
+#ifdef CC_FEATURES
+void defineNativeSignature(const char* name, NativeFn function,
+                           int minArity, int maxArity, const char* argTypes) {
+  ObjNative* native = addNative(name, function);
+  native->minArity = minArity;
+  native->maxArity = maxArity;
+  native->argTypes = argTypes;
+}
+#endif
+
+
+#ifdef CC_FEATURES
+// The natives behind OP_ARRAY_GET..OP_HASH_GET, in opcode order.
+static const char* intrinsicNativeNames[INTRINSIC_COUNT] = {
+  "ar_get", "ar_set", "ar_count", "ar_push", "ht_get"
+};
+
+
+static void initIntrinsics() {
+  for (int i = 0; i < INTRINSIC_COUNT; i++) {
+    const char* name = intrinsicNativeNames[i];
+    vm.intrinsicNames[i] = copyString(name, (int)strlen(name));
+    vm.intrinsicShadowed[i] = false;
+  }
+}
+
+
+// Returns the intrinsic opcode the compiler may emit for a call to the named
+// global, or -1 if there isn't one.
+int intrinsicOpcode(ObjString* name) {
+  for (int i = 0; i < INTRINSIC_COUNT; i++) {
+    if (vm.intrinsicNames[i] == name) {
+      return OP_ARRAY_GET + i;
+    }
+  }
+  return -1;
+}
+
+
+// Once a script assigns to one of the intrinsic natives' globals, the
+// matching opcode stops taking its fast path and calls whatever is there now.
+static void noteGlobalAssignment(ObjString* name) {
+  for (int i = 0; i < INTRINSIC_COUNT; i++) {
+    if (vm.intrinsicNames[i] == name) {
+      vm.intrinsicShadowed[i] = true;
+    }
+  }
 }
+#endif
 
 
 void initVM() {
@@ -80,14 +145,24 @@ void initVM() {
   defineNative("clock", clockNative);
 
 #ifdef CC_FEATURES
+  cc_init_ferrors();
   cc_register_ext_functions();
   cc_register_ext_userhash();
   cc_register_ext_userarray();
+  initIntrinsics();
 #endif
 }
 
 
 void freeVM() {
+#ifdef CC_FEATURES
+  profilerFinish();
+#endif
+#ifdef DEBUG_OPCODE_STATS
+  statsDump();
+#endif
+  workersStop();
+  if (memoryReportAtExit) printMemoryReport();
   freeTable(&vm.globals);
   freeTable(&vm.strings);
   freeObjects();
@@ -106,11 +181,6 @@ Value pop() {
 }
 
 
-static Value peek(int distance) {
-  return vm.stackTop[-1 - distance];
-}
-
-
 static bool call(ObjFunction* function, int argCount) {
   if (argCount != function->arity) {
     runtimeError("Expected %d arguments but got %d.", function->arity, argCount);
@@ -131,6 +201,41 @@ static bool call(ObjFunction* function, int argCount) {
 }
 
 
+#ifdef CC_FEATURES
+static bool nativeArgumentMatches(char argType, Value value) {
+  switch (argType) {
+    case 'n': return IS_NUMBER(value);
+    case 's': return IS_STRING(value);
+    case 'a': return IS_USERARRAY(value);
+    case 'h': return IS_USERHASH(value);
+    case 'f': return IS_FILEHANDLE(value);
+    case 'm': return IS_FILEMAP(value);
+    case 'c': return IS_FUNCTION(value);
+    default:  return true;
+  }
+}
+
+
+// Returns the ferror id describing the first problem with the arguments being
+// passed to the native, or FE_NONE if the call can go ahead.
+static int checkNativeArguments(ObjNative* native, int argCount, Value* args) {
+  if (argCount < native->minArity ||
+      (native->maxArity != NATIVE_VARIADIC && argCount > native->maxArity)) {
+    return cc_ferror_for_arg_count(native->minArity, native->maxArity);
+  }
+  if (native->argTypes == NULL) {
+    return FE_NONE;
+  }
+  for (int i = 0; i < argCount && native->argTypes[i] != '\0'; i++) {
+    if (!nativeArgumentMatches(native->argTypes[i], args[i])) {
+      return cc_ferror_for_arg_type(i + 1, native->argTypes[i]);
+    }
+  }
+  return FE_NONE;
+}
+#endif
+
+
 static bool callValue(Value callee, int argCount) {
   if (IS_OBJ(callee)) {
     switch (OBJ_TYPE(callee)) {
@@ -140,14 +245,43 @@ static bool callValue(Value callee, int argCount) {
 
       case OBJ_NATIVE: {
         ObjNative *native = AS_NATIVE(callee);
+#ifdef CC_FEATURES
+        int arg_error = checkNativeArguments(native, argCount, vm.stackTop - argCount);
+        if (arg_error != FE_NONE) {
+          runtimeError("%s(): %s", native->name->chars, cc_ferror_to_string(arg_error));
+          return false;
+        }
+#endif
         NativeFn func = native->function;
+#ifdef CC_FEATURES
+        int frameCount = vm.frameCount;
+#endif
+#ifdef DEBUG_OPCODE_STATS
+        uint64_t started = statsNow();
+#endif
         Value result = func(argCount, vm.stackTop - argCount);
+#ifdef DEBUG_OPCODE_STATS
+        native->statsCalls++;
+        native->statsNanos += statsNow() - started;
+#endif
         bool had_error = false;
 #ifdef CC_FEATURES
+        // A Lox callback that hit a runtime error has already reported it and
+        // reset the stack, so there's no frame left to return to.
+        if (vm.frameCount < frameCount) {
+          return false;
+        }
         if(IS_FERROR(result)) {
           had_error = true;
           ObjFunctionError* err = AS_FERROR(result);
-          if(err->sys_errno == 0) {
+          if(err->detail != NULL) {
+            runtimeError(
+              "%s(): %s: %s",
+              native->name->chars,
+              cc_ferror_to_string(err->ferror_id),
+              err->detail
+            );
+          } else if(err->sys_errno == 0) {
             runtimeError(
               "%s(): %s",
               native->name->chars,
@@ -182,6 +316,23 @@ static bool callValue(Value callee, int argCount) {
 
 
 #ifdef CC_FEATURES
+// Slow path for the intrinsic opcodes.  Look the callee up by name the way
+// OP_GET_GLOBAL would, slide it in underneath the arguments already on the
+// stack, then make an ordinary call.
+static bool callIntrinsicByName(ObjString* name, int argCount) {
+  Value callee;
+  if (!tableGet(&vm.globals, name, &callee)) {
+    runtimeError("Undefined variable '%s'.", name->chars);
+    return false;
+  }
+  Value* args = vm.stackTop - argCount;
+  memmove(args + 1, args, sizeof(Value) * argCount);
+  *args = callee;
+  vm.stackTop++;
+  return callValue(callee, argCount);
+}
+
+
 static InterpretResult run(int until_frame); // lol
 
 Value callCallback(Value callback, int argCount, Value* args) {
@@ -228,7 +379,7 @@ static void concatenate() {
   ObjString* b = AS_STRING(pop());
   ObjString* a = AS_STRING(pop());
 
-  int length = a->length + b->length;
+  int64_t length = a->length + b->length;
   char* chars = ALLOCATE(char, length + 1);
   memcpy(chars, a->chars, a->length);
   memcpy(chars + a->length, b->chars, b->length);
@@ -238,30 +389,428 @@ static void concatenate() {
   push(OBJ_VAL(result));
 }
 
+#ifdef CC_JIT
+// Instruction helpers for JIT compiled code, each doing the work of the
+// matching case in run() directly on vm.stackTop.  Anything that can report an
+// error or call out first stores ip in the frame, like SAVE_FRAME() does.
+
+#define JIT_CONSTANT(index) (frame->function->chunk.constants.values[index])
+
+#define JIT_ERROR_RETURN(...) \
+    do { \
+      frame->ip = ip; \
+      runtimeError(__VA_ARGS__); \
+      return JIT_ERROR; \
+    } while (false)
+
+#define JIT_BINARY_OP(name, valueType, op) \
+    int name(CallFrame* frame, uint8_t* ip) { \
+      Value* top = vm.stackTop; \
+      if (!IS_NUMBER(top[-1]) || !IS_NUMBER(top[-2])) { \
+        JIT_ERROR_RETURN("Operands must be numbers."); \
+      } \
+      top[-2] = valueType(AS_NUMBER(top[-2]) op AS_NUMBER(top[-1])); \
+      vm.stackTop = top - 1; \
+      return JIT_CONTINUE; \
+    }
+
+
+int jitOpNil(CallFrame* frame, uint8_t* ip) {
+  push(NIL_VAL);
+  return JIT_CONTINUE;
+}
+
+
+int jitOpTrue(CallFrame* frame, uint8_t* ip) {
+  push(BOOL_VAL(true));
+  return JIT_CONTINUE;
+}
+
+
+int jitOpFalse(CallFrame* frame, uint8_t* ip) {
+  push(BOOL_VAL(false));
+  return JIT_CONTINUE;
+}
+
+
+int jitOpGetGlobal(CallFrame* frame, uint8_t* ip) {
+  ObjString* name = AS_STRING(JIT_CONSTANT(ip[-1]));
+  Value value;
+  if (!tableGet(&vm.globals, name, &value)) {
+    JIT_ERROR_RETURN("Undefined variable '%s'.", name->chars);
+  }
+  push(value);
+  return JIT_CONTINUE;
+}
+
+
+int jitOpDefineGlobal(CallFrame* frame, uint8_t* ip) {
+  ObjString* name = AS_STRING(JIT_CONSTANT(ip[-1]));
+  noteGlobalAssignment(name);
+  tableSet(&vm.globals, name, vm.stackTop[-1]);
+  vm.stackTop--;
+  return JIT_CONTINUE;
+}
+
+
+int jitOpSetGlobal(CallFrame* frame, uint8_t* ip) {
+  ObjString* name = AS_STRING(JIT_CONSTANT(ip[-1]));
+  if (tableSet(&vm.globals, name, vm.stackTop[-1])) {
+    tableDelete(&vm.globals, name);
+    JIT_ERROR_RETURN("Undefined variable '%s'.", name->chars);
+  }
+  noteGlobalAssignment(name);
+  return JIT_CONTINUE;
+}
+
+
+int jitOpEqual(CallFrame* frame, uint8_t* ip) {
+  Value* top = vm.stackTop;
+  top[-2] = BOOL_VAL(valuesEqual(top[-2], top[-1]));
+  vm.stackTop = top - 1;
+  return JIT_CONTINUE;
+}
+
+
+JIT_BINARY_OP(jitOpGreater,  BOOL_VAL,   >)
+JIT_BINARY_OP(jitOpLess,     BOOL_VAL,   <)
+JIT_BINARY_OP(jitOpSubtract, NUMBER_VAL, -)
+JIT_BINARY_OP(jitOpMultiply, NUMBER_VAL, *)
+JIT_BINARY_OP(jitOpDivide,   NUMBER_VAL, /)
+
+
+int jitOpAdd(CallFrame* frame, uint8_t* ip) {
+  Value* top = vm.stackTop;
+  if (IS_NUMBER(top[-1]) && IS_NUMBER(top[-2])) {
+    top[-2] = NUMBER_VAL(AS_NUMBER(top[-2]) + AS_NUMBER(top[-1]));
+    vm.stackTop = top - 1;
+  } else if (IS_STRING(top[-1]) && IS_STRING(top[-2])) {
+    concatenate();
+  } else {
+    JIT_ERROR_RETURN("Operands must be two numbers or two strings.");
+  }
+  return JIT_CONTINUE;
+}
+
+
+int jitOpNot(CallFrame* frame, uint8_t* ip) {
+  vm.stackTop[-1] = BOOL_VAL(isFalsey(vm.stackTop[-1]));
+  return JIT_CONTINUE;
+}
+
+
+int jitOpNegate(CallFrame* frame, uint8_t* ip) {
+  if (!IS_NUMBER(vm.stackTop[-1])) {
+    JIT_ERROR_RETURN("Operand must be a number.");
+  }
+  vm.stackTop[-1] = NUMBER_VAL(-AS_NUMBER(vm.stackTop[-1]));
+  return JIT_CONTINUE;
+}
+
+
+int jitOpPrint(CallFrame* frame, uint8_t* ip) {
+  printValue(pop());
+  printf("\n");
+  return JIT_CONTINUE;
+}
+
+
+static bool runCompiled(int until_frame, InterpretResult* result);
+
+// Runs the frame a call just pushed, if it pushed one, through to its return.
+// Compiled callees are entered directly, the rest go through the interpreter.
+static int jitFinishCall(int frameCount) {
+  if (vm.frameCount == frameCount) {
+    return JIT_CONTINUE;
+  }
+
+  InterpretResult result;
+  if (!jitReady(vm.frames[vm.frameCount - 1].function, false) ||
+      !runCompiled(frameCount, &result)) {
+    result = run(frameCount);
+  }
+  return result == INTERPRET_OK ? JIT_CONTINUE : JIT_ERROR;
+}
+
+
+int jitOpCall(CallFrame* frame, uint8_t* ip) {
+  int argCount = ip[-1];
+  int frameCount = vm.frameCount;
+  frame->ip = ip;
+  if (!callValue(vm.stackTop[-1 - argCount], argCount)) {
+    return JIT_ERROR;
+  }
+  return jitFinishCall(frameCount);
+}
+
+
+int jitOpReturn(CallFrame* frame, uint8_t* ip) {
+  Value result = pop();
+  vm.frameCount--;
+  if (vm.frameCount == 0) {
+    pop();
+    return JIT_RETURNED;
+  }
+  vm.stackTop = frame->slots;
+  push(result);
+  return JIT_RETURNED;
+}
+
+
+int jitOpTailCall(CallFrame* frame, uint8_t* ip) {
+  int argCount = ip[-1];
+  Value callee = vm.stackTop[-1 - argCount];
+  frame->ip = ip;
+  if (IS_FUNCTION(callee)) {
+    ObjFunction* function = AS_FUNCTION(callee);
+    if (argCount != function->arity) {
+      JIT_ERROR_RETURN("Expected %d arguments but got %d.", function->arity, argCount);
+    }
+    memmove(frame->slots, vm.stackTop - argCount - 1, sizeof(Value) * (argCount + 1));
+    vm.stackTop = frame->slots + argCount + 1;
+    frame->function = function;
+    frame->ip = function->chunk.code;
+    return JIT_REPLACED;
+  }
+
+  if (!callValue(callee, argCount)) {
+    return JIT_ERROR;
+  }
+  return jitOpReturn(frame, ip);
+}
+
+
+int jitOpExit(CallFrame* frame, uint8_t* ip) {
+  double errorlevel = AS_NUMBER(pop());
+  if (errorlevel > 255 || errorlevel < 0) {
+    JIT_ERROR_RETURN("Exit value must be between 0 and 255, inclusive.");
+  }
+  freeVM();
+  exit( (int)errorlevel );
+}
+
+
+int jitOpEcho(CallFrame* frame, uint8_t* ip) {
+  uint8_t arg_count = ip[-1];
+  for (int i = arg_count; i > 0; i--) {
+    printValue(vm.stackTop[-i]);
+  }
+  vm.stackTop -= arg_count;
+  return JIT_CONTINUE;
+}
+
+
+// Shares one helper between all of the intrinsic opcodes.  Well-typed calls go
+// straight to the native's C function, everything else through the global.
+int jitOpIntrinsic(CallFrame* frame, uint8_t* ip) {
+  OpCode op = ip[-3];
+  int argCount = ip[-1];
+  Value* args = vm.stackTop - argCount;
+
+  NativeFn function = NULL;
+  if (!vm.intrinsicShadowed[op - OP_ARRAY_GET]) {
+    switch (op) {
+      case OP_ARRAY_GET:
+        if (argCount == 2 && IS_USERARRAY(args[0]) && IS_NUMBER(args[1])) {
+          ObjUserArray* ua = AS_USERARRAY(args[0]);
+          double index = AS_NUMBER(args[1]);
+          if (index >= 0 && index < ua->inner.count) {
+            args[0] = ua->inner.values[(int64_t)index];
+            vm.stackTop = args + 1;
+            return JIT_CONTINUE;
+          }
+          function = cc_function_ar_get;
+        }
+        break;
+      case OP_ARRAY_SET:
+        if (argCount == 3 && IS_USERARRAY(args[0]) && IS_NUMBER(args[1])) {
+          ObjUserArray* ua = AS_USERARRAY(args[0]);
+          double index = AS_NUMBER(args[1]);
+          if (index >= 0 && index < ua->inner.count) {
+            ua->inner.values[(int64_t)index] = args[2];
+            args[0] = BOOL_VAL(true);
+            vm.stackTop = args + 1;
+            return JIT_CONTINUE;
+          }
+          function = cc_function_ar_set;
+        }
+        break;
+      case OP_ARRAY_COUNT:
+        if (argCount == 1 && IS_USERARRAY(args[0])) {
+          args[0] = NUMBER_VAL(AS_USERARRAY(args[0])->inner.count);
+          return JIT_CONTINUE;
+        }
+        break;
+      case OP_ARRAY_PUSH:
+        if (argCount == 2 && IS_USERARRAY(args[0])) {
+          function = cc_function_ar_push;
+        }
+        break;
+      case OP_HASH_GET:
+        if (argCount == 2 && IS_USERHASH(args[0]) && IS_STRING(args[1])) {
+          Value result = NIL_VAL;
+          tableGet(&AS_USERHASH(args[0])->table, AS_STRING(args[1]), &result);
+          args[0] = result;
+          vm.stackTop = args + 1;
+          return JIT_CONTINUE;
+        }
+        break;
+      default:
+        break;
+    }
+  }
+
+  if (function != NULL) {
+    args[0] = function(argCount, args);
+    vm.stackTop = args + 1;
+    return JIT_CONTINUE;
+  }
+
+  int frameCount = vm.frameCount;
+  frame->ip = ip;
+  if (!callIntrinsicByName(AS_STRING(JIT_CONSTANT(ip[-2])), argCount)) {
+    return JIT_ERROR;
+  }
+  return jitFinishCall(frameCount);
+}
+
+#undef JIT_CONSTANT
+#undef JIT_ERROR_RETURN
+#undef JIT_BINARY_OP
+
+
+// Runs compiled code for the frame on top of the stack, and keeps going for as
+// long as control stays in compiled functions: returns into compiled callers
+// and tail calls into compiled functions.  Returns true when run() should stop
+// and return *result, false when it should pick the top frame back up.
+static bool runCompiled(int until_frame, InterpretResult* result) {
+  for (;;) {
+    JitStatus status = jitEnter(&vm.frames[vm.frameCount - 1]);
+    if (status == JIT_ERROR) {
+      *result = INTERPRET_RUNTIME_ERROR;
+      return true;
+    }
+    if (status == JIT_RETURNED &&
+        (vm.frameCount == 0 || vm.frameCount == until_frame)) {
+      *result = INTERPRET_OK;
+      return true;
+    }
+    if (!jitReady(vm.frames[vm.frameCount - 1].function, status == JIT_REPLACED)) {
+      return false;
+    }
+  }
+}
+#endif
+
 #ifdef CC_FEATURES
 static InterpretResult run(int until_frame) {
 #else
 static InterpretResult run() {
 #endif
+  // The instruction pointer, the current frame's slots and the top of the stack
+  // are the three things touched by nearly every instruction.  Keep them in
+  // locals so the compiler can hold them in registers instead of going through
+  // frame and vm on every access.  They're written back with SAVE_FRAME()
+  // before anything that looks at the VM from the outside (calls, natives,
+  // callbacks, runtime errors), and reloaded with LOAD_FRAME() afterwards.
   CallFrame* frame = &vm.frames[vm.frameCount - 1];
+  register uint8_t* ip = frame->ip;
+  register Value* slots = frame->slots;
+  register Value* stackTop = vm.stackTop;
 
-#define READ_BYTE() (*frame->ip++)
-#define READ_SHORT() (frame->ip += 2, (uint16_t)((frame->ip[-2] << 8) | frame->ip[-1]))
+#define READ_BYTE() (*ip++)
+#define READ_SHORT() (ip += 2, (uint16_t)((ip[-2] << 8) | ip[-1]))
 #define READ_CONSTANT() (frame->function->chunk.constants.values[READ_BYTE()])
 #define READ_STRING() AS_STRING(READ_CONSTANT())
 
-#define BINARY_OP(valueType, op) \
+#define PUSH(value) (*stackTop++ = (value))
+#define POP() (*--stackTop)
+#define DROP() (stackTop--)
+#define PEEK(distance) (stackTop[-1 - (distance)])
+
+#define SAVE_FRAME() \
     do { \
-      if (!IS_NUMBER(peek(0)) || !IS_NUMBER(peek(1))) { \
-        runtimeError("Operands must be numbers."); \
-        return INTERPRET_RUNTIME_ERROR; \
+      frame->ip = ip; \
+      vm.stackTop = stackTop; \
+    } while (false)
+
+#define LOAD_FRAME() \
+    do { \
+      frame = &vm.frames[vm.frameCount - 1]; \
+      ip = frame->ip; \
+      slots = frame->slots; \
+      stackTop = vm.stackTop; \
+    } while (false)
+
+#define RUNTIME_ERROR(...) \
+    do { \
+      SAVE_FRAME(); \
+      runtimeError(__VA_ARGS__); \
+      return INTERPRET_RUNTIME_ERROR; \
+    } while (false)
+
+// The generic instruction rewrites itself into its number-only variant, so the
+// next time through this site skips straight to the arithmetic.
+#define BINARY_OP(valueType, op, quickOp) \
+    do { \
+      if (!IS_NUMBER(PEEK(0)) || !IS_NUMBER(PEEK(1))) { \
+        RUNTIME_ERROR("Operands must be numbers."); \
       } \
+      ip[-1] = quickOp; \
       \
-      double b = AS_NUMBER(pop()); \
-      double a = AS_NUMBER(pop()); \
-      push(valueType(a op b)); \
+      double b = AS_NUMBER(POP()); \
+      double a = AS_NUMBER(POP()); \
+      PUSH(valueType(a op b)); \
     } while (false)
 
+// The number-only variant.  If the guard fails, put the generic instruction
+// back and dispatch it again.  It'll deal with strings and with errors.
+#define NUMBER_OP(valueType, op, genericOp) \
+    do { \
+      if (!IS_NUMBER(PEEK(0)) || !IS_NUMBER(PEEK(1))) { \
+        ip[-1] = genericOp; \
+        ip--; \
+        break; \
+      } \
+      stackTop[-2] = valueType(AS_NUMBER(stackTop[-2]) op AS_NUMBER(stackTop[-1])); \
+      stackTop--; \
+    } while (false)
+
+#ifdef CC_FEATURES
+#define INTRINSIC_READY(op, expectedArgs) \
+    (!vm.intrinsicShadowed[(op) - OP_ARRAY_GET] && argCount == (expectedArgs))
+
+#define CALL_INTRINSIC_BY_NAME(name, argCount) \
+    do { \
+      SAVE_FRAME(); \
+      if (!callIntrinsicByName(name, argCount)) { \
+        return INTERPRET_RUNTIME_ERROR; \
+      } \
+      LOAD_FRAME(); \
+    } while (false)
+#endif
+
+// Hands the current frame over to compiled code if its function has some,
+// optionally counting this as a visit towards compiling it.  The interpreter
+// only carries on from here if control comes back to an interpreted frame.
+#ifdef CC_JIT
+#define JIT_CHECK(countVisit) \
+    do { \
+      if (jitReady(frame->function, countVisit)) { \
+        SAVE_FRAME(); \
+        InterpretResult jitResult; \
+        if (runCompiled(until_frame, &jitResult)) { \
+          return jitResult; \
+        } \
+        LOAD_FRAME(); \
+      } \
+    } while (false)
+#else
+#define JIT_CHECK(countVisit) do { } while (false)
+#endif
+
+  JIT_CHECK(true);
+
 // @TODO Hey, why is this a for instead of a while(true)
   for (;;) {
 
@@ -269,8 +818,8 @@ static InterpretResult run() {
     bool found_things_on_stack = false;
     printf("\nS   ");
     int stack_count = 0;
-    for (Value* slot = vm.stack; slot < vm.stackTop; slot++) {
-      if(slot == frame->slots) {
+    for (Value* slot = vm.stack; slot < stackTop; slot++) {
+      if(slot == slots) {
         printf("FRAME > ");
       }
       found_things_on_stack = true;
@@ -303,33 +852,43 @@ static InterpretResult run() {
     }
     printf("\n");
 
-    disassembleInstruction(&frame->function->chunk, (int)(frame->ip - frame->function->chunk.code));
+    disassembleInstruction(&frame->function->chunk, (int)(ip - frame->function->chunk.code));
+#endif
+
+#ifdef CC_FEATURES
+    if (profilerPending) {
+      SAVE_FRAME();
+      profilerSample();
+    }
 #endif
 
-    uint8_t instruction;
-    switch (instruction = READ_BYTE()) {
+    uint8_t instruction = READ_BYTE();
+#ifdef DEBUG_OPCODE_STATS
+    statsCountInstruction(instruction);
+#endif
+    switch (instruction) {
 
       case OP_CONSTANT: {
         Value constant = READ_CONSTANT();
-        push(constant);
+        PUSH(constant);
         break;
       }
 
-      case OP_NIL:      push(NIL_VAL); break;
-      case OP_TRUE:     push(BOOL_VAL(true)); break;
-      case OP_FALSE:    push(BOOL_VAL(false)); break;
+      case OP_NIL:      PUSH(NIL_VAL); break;
+      case OP_TRUE:     PUSH(BOOL_VAL(true)); break;
+      case OP_FALSE:    PUSH(BOOL_VAL(false)); break;
 
-      case OP_POP:  pop(); break;
+      case OP_POP:  DROP(); break;
 
       case OP_GET_LOCAL: {
         uint8_t slot = READ_BYTE();
-        push(frame->slots[slot]);
+        PUSH(slots[slot]);
         break;
       }
 
       case OP_SET_LOCAL: {
         uint8_t slot = READ_BYTE();
-        frame->slots[slot] = peek(0);
+        slots[slot] = PEEK(0);
         break;
       }
 
@@ -337,115 +896,160 @@ static InterpretResult run() {
         ObjString* name = READ_STRING();
         Value value;
         if (!tableGet(&vm.globals, name, &value)) {
-          runtimeError("Undefined variable '%s'.", name->chars);
-          return INTERPRET_RUNTIME_ERROR;
+          RUNTIME_ERROR("Undefined variable '%s'.", name->chars);
         }
-        push(value);
+        PUSH(value);
         break;
       }
 
       case OP_DEFINE_GLOBAL: {
         ObjString* name = READ_STRING();
-        tableSet(&vm.globals, name, peek(0));
-        pop();
+#ifdef CC_FEATURES
+        noteGlobalAssignment(name);
+#endif
+        tableSet(&vm.globals, name, PEEK(0));
+        DROP();
         break;
       }
 
       case OP_SET_GLOBAL: {
         ObjString* name = READ_STRING();
-        if (tableSet(&vm.globals, name, peek(0))) {
+        if (tableSet(&vm.globals, name, PEEK(0))) {
           tableDelete(&vm.globals, name);
-          runtimeError("Undefined variable '%s'.", name->chars);
-          return INTERPRET_RUNTIME_ERROR;
+          RUNTIME_ERROR("Undefined variable '%s'.", name->chars);
         }
+#ifdef CC_FEATURES
+        noteGlobalAssignment(name);
+#endif
         break;
       }
 
       case OP_EQUAL: {
-        Value b = pop();
-        Value a = pop();
-        push(BOOL_VAL(valuesEqual(a, b)));
+        Value b = POP();
+        Value a = POP();
+        PUSH(BOOL_VAL(valuesEqual(a, b)));
         break;
       }
 
-      case OP_GREATER:  BINARY_OP(BOOL_VAL, >);   break;
-      case OP_LESS:     BINARY_OP(BOOL_VAL, <);   break;
+      case OP_GREATER:  BINARY_OP(BOOL_VAL, >, OP_GREATER_NUM);   break;
+      case OP_LESS:     BINARY_OP(BOOL_VAL, <, OP_LESS_NUM);      break;
       case OP_ADD: {
-        if (IS_STRING(peek(0)) && IS_STRING(peek(1))) {
+        if (IS_NUMBER(PEEK(0)) && IS_NUMBER(PEEK(1))) {
+          ip[-1] = OP_ADD_NUM;
+          double b = AS_NUMBER(POP());
+          double a = AS_NUMBER(POP());
+          PUSH(NUMBER_VAL(a + b));
+        } else if (IS_STRING(PEEK(0)) && IS_STRING(PEEK(1))) {
+          vm.stackTop = stackTop;
           concatenate();
-        } else if (IS_NUMBER(peek(0)) && IS_NUMBER(peek(1))) {
-          double b = AS_NUMBER(pop());
-          double a = AS_NUMBER(pop());
-          push(NUMBER_VAL(a + b));
+          stackTop = vm.stackTop;
         } else {
-          runtimeError("Operands must be two numbers or two strings.");
-          return INTERPRET_RUNTIME_ERROR;
+          RUNTIME_ERROR("Operands must be two numbers or two strings.");
         }
         break;
       }
-      case OP_SUBTRACT: BINARY_OP(NUMBER_VAL, -); break;
-      case OP_MULTIPLY: BINARY_OP(NUMBER_VAL, *); break;
-      case OP_DIVIDE:   BINARY_OP(NUMBER_VAL, /); break;
+      case OP_SUBTRACT: BINARY_OP(NUMBER_VAL, -, OP_SUBTRACT_NUM); break;
+      case OP_MULTIPLY: BINARY_OP(NUMBER_VAL, *, OP_MULTIPLY_NUM); break;
+      case OP_DIVIDE:   BINARY_OP(NUMBER_VAL, /, OP_DIVIDE_NUM);   break;
+
+      case OP_GREATER_NUM:  NUMBER_OP(BOOL_VAL, >, OP_GREATER);     break;
+      case OP_LESS_NUM:     NUMBER_OP(BOOL_VAL, <, OP_LESS);        break;
+      case OP_ADD_NUM:      NUMBER_OP(NUMBER_VAL, +, OP_ADD);       break;
+      case OP_SUBTRACT_NUM: NUMBER_OP(NUMBER_VAL, -, OP_SUBTRACT);  break;
+      case OP_MULTIPLY_NUM: NUMBER_OP(NUMBER_VAL, *, OP_MULTIPLY);  break;
+      case OP_DIVIDE_NUM:   NUMBER_OP(NUMBER_VAL, /, OP_DIVIDE);    break;
+
       case OP_NOT:
-        push(BOOL_VAL(isFalsey(pop())));
+        stackTop[-1] = BOOL_VAL(isFalsey(stackTop[-1]));
         break;
 
       case OP_NEGATE:
-        if (!IS_NUMBER(peek(0))) {
-          runtimeError("Operand must be a number.");
-          return INTERPRET_RUNTIME_ERROR;
+        if (!IS_NUMBER(PEEK(0))) {
+          RUNTIME_ERROR("Operand must be a number.");
         }
 
-        push(NUMBER_VAL(-AS_NUMBER(pop())));
-        break;
+        stackTop[-1] = NUMBER_VAL(-AS_NUMBER(stackTop[-1]));
         break;
 
       case OP_PRINT: {
-        printValue(pop());
+        printValue(POP());
         printf("\n");
         break;
       }
 
       case OP_JUMP: {
         uint16_t offset = READ_SHORT();
-        frame->ip += offset;
+        ip += offset;
         break;
       }
 
       case OP_JUMP_IF_FALSE: {
         uint16_t offset = READ_SHORT();
-        if (isFalsey(peek(0))) frame->ip += offset;
+        if (isFalsey(PEEK(0))) ip += offset;
         break;
       }
 
       case OP_LOOP: {
         uint16_t offset = READ_SHORT();
-        frame->ip -= offset;
+        ip -= offset;
+        JIT_CHECK(true);
         break;
       }
 
       case OP_CALL: {
         int argCount = READ_BYTE();
-        if (!callValue(peek(argCount), argCount)) {
+        SAVE_FRAME();
+        if (!callValue(PEEK(argCount), argCount)) {
           return INTERPRET_RUNTIME_ERROR;
         }
-        frame = &vm.frames[vm.frameCount - 1];
+        LOAD_FRAME();
+        // Only a Lox function call leaves us at the start of a chunk.
+        JIT_CHECK(ip == frame->function->chunk.code);
         break;
       }
 
+      case OP_TAIL_CALL: {
+        int argCount = READ_BYTE();
+        Value callee = PEEK(argCount);
+        if (IS_FUNCTION(callee)) {
+          // Slide the callee and its arguments down over our own window and
+          // start the new function in this frame.
+          ObjFunction* function = AS_FUNCTION(callee);
+          if (argCount != function->arity) {
+            RUNTIME_ERROR("Expected %d arguments but got %d.", function->arity, argCount);
+          }
+          memmove(slots, stackTop - argCount - 1, sizeof(Value) * (argCount + 1));
+          stackTop = slots + argCount + 1;
+          frame->function = function;
+          ip = function->chunk.code;
+          JIT_CHECK(true);
+          break;
+        }
+
+        // Natives and errors go through the usual call.  A native leaves its
+        // result on the stack, which the fall through into OP_RETURN returns.
+        SAVE_FRAME();
+        if (!callValue(callee, argCount)) {
+          return INTERPRET_RUNTIME_ERROR;
+        }
+        LOAD_FRAME();
+      }
+      // Fall through.
+
       case OP_RETURN: {
-        Value result = pop();
+        Value result = POP();
 
         vm.frameCount--;
         if (vm.frameCount == 0) {
-          pop();
+          DROP();
+          vm.stackTop = stackTop;
           return INTERPRET_OK; // This exits.
         }
 
-        vm.stackTop = frame->slots;
+        vm.stackTop = slots;
         push(result);
 
-        frame = &vm.frames[vm.frameCount - 1];
+        LOAD_FRAME();
 
 #ifdef CC_FEATURES
         // If we're inside of a callback, return control to the calling context
@@ -455,16 +1059,16 @@ static InterpretResult run() {
         }
 #endif
 
+        JIT_CHECK(false);
         break;
       }
 
 #ifdef CC_FEATURES
       case OP_EXIT: {
         // POSIX says to only use 8 bits out of the 16 bit ("int" type) exit value
-        double errorlevel = AS_NUMBER(pop());
+        double errorlevel = AS_NUMBER(POP());
         if(errorlevel > 255 || errorlevel < 0) {
-          runtimeError("Exit value must be between 0 and 255, inclusive.");
-          return INTERPRET_RUNTIME_ERROR;
+          RUNTIME_ERROR("Exit value must be between 0 and 255, inclusive.");
         }
 
         // This is a clean exit.  Tear down the environment to let the (future)
@@ -486,11 +1090,11 @@ static InterpretResult run() {
         uint8_t arg_count = READ_BYTE();
         uint8_t pops = 0;
         while(arg_count-- > 0) {
-          printValue(peek(arg_count));
+          printValue(PEEK(arg_count));
           pops++;
         }
         while(pops-- > 0) {
-          pop();
+          DROP();
         }
         break;
       }
@@ -500,14 +1104,96 @@ static InterpretResult run() {
         // Our work was done in the compiler.  The filename that was transacluded
         // is forced into the chunk because of how the string parser works, so
         // let's clean that up now.  @FIXME This is dumb.
-        pop();
+        DROP();
         break;
       }
 
+#ifdef CC_FEATURES
+      // The fast paths below only cover the common in-bounds cases inline and
+      // hand everything else to the native itself, which is still sitting in
+      // the global table.  Wrong argument counts or types, and globals the
+      // script has reassigned, go through a normal call so errors read the same.
+      case OP_ARRAY_GET: {
+        ObjString* name = READ_STRING();
+        int argCount = READ_BYTE();
+        if (INTRINSIC_READY(OP_ARRAY_GET, 2) &&
+            IS_USERARRAY(PEEK(1)) && IS_NUMBER(PEEK(0))) {
+          ObjUserArray* ua = AS_USERARRAY(PEEK(1));
+          double index = AS_NUMBER(PEEK(0));
+          if (index >= 0 && index < ua->inner.count) {
+            stackTop[-2] = ua->inner.values[(int64_t)index];
+          } else {
+            stackTop[-2] = cc_function_ar_get(2, stackTop - 2);
+          }
+          DROP();
+          break;
+        }
+        CALL_INTRINSIC_BY_NAME(name, argCount);
+        break;
+      }
+
+      case OP_ARRAY_SET: {
+        ObjString* name = READ_STRING();
+        int argCount = READ_BYTE();
+        if (INTRINSIC_READY(OP_ARRAY_SET, 3) &&
+            IS_USERARRAY(PEEK(2)) && IS_NUMBER(PEEK(1))) {
+          ObjUserArray* ua = AS_USERARRAY(PEEK(2));
+          double index = AS_NUMBER(PEEK(1));
+          if (index >= 0 && index < ua->inner.count) {
+            ua->inner.values[(int64_t)index] = PEEK(0);
+            stackTop[-3] = BOOL_VAL(true);
+          } else {
+            stackTop[-3] = cc_function_ar_set(3, stackTop - 3);
+          }
+          stackTop -= 2;
+          break;
+        }
+        CALL_INTRINSIC_BY_NAME(name, argCount);
+        break;
+      }
+
+      case OP_ARRAY_COUNT: {
+        ObjString* name = READ_STRING();
+        int argCount = READ_BYTE();
+        if (INTRINSIC_READY(OP_ARRAY_COUNT, 1) && IS_USERARRAY(PEEK(0))) {
+          stackTop[-1] = NUMBER_VAL(AS_USERARRAY(PEEK(0))->inner.count);
+          break;
+        }
+        CALL_INTRINSIC_BY_NAME(name, argCount);
+        break;
+      }
+
+      case OP_ARRAY_PUSH: {
+        ObjString* name = READ_STRING();
+        int argCount = READ_BYTE();
+        if (INTRINSIC_READY(OP_ARRAY_PUSH, 2) && IS_USERARRAY(PEEK(1))) {
+          stackTop[-2] = cc_function_ar_push(2, stackTop - 2);
+          DROP();
+          break;
+        }
+        CALL_INTRINSIC_BY_NAME(name, argCount);
+        break;
+      }
+
+      case OP_HASH_GET: {
+        ObjString* name = READ_STRING();
+        int argCount = READ_BYTE();
+        if (INTRINSIC_READY(OP_HASH_GET, 2) &&
+            IS_USERHASH(PEEK(1)) && IS_STRING(PEEK(0))) {
+          Value result = NIL_VAL;
+          tableGet(&AS_USERHASH(PEEK(1))->table, AS_STRING(PEEK(0)), &result);
+          stackTop[-2] = result;
+          DROP();
+          break;
+        }
+        CALL_INTRINSIC_BY_NAME(name, argCount);
+        break;
+      }
+#endif
+
       // Variation
       default: {
-        runtimeError("Unknown opcode %d.", instruction);
-        return INTERPRET_RUNTIME_ERROR;
+        RUNTIME_ERROR("Unknown opcode %d.", instruction);
       }
 
     }
@@ -517,7 +1203,18 @@ static InterpretResult run() {
 #undef READ_SHORT
 #undef READ_CONSTANT
 #undef READ_STRING
+#undef PUSH
+#undef POP
+#undef DROP
+#undef PEEK
+#undef SAVE_FRAME
+#undef LOAD_FRAME
+#undef RUNTIME_ERROR
 #undef BINARY_OP
+#undef NUMBER_OP
+#undef INTRINSIC_READY
+#undef CALL_INTRINSIC_BY_NAME
+#undef JIT_CHECK
 }
 
 
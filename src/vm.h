@@ -8,6 +8,11 @@
 #define FRAMES_MAX 64
 #define STACK_MAX (FRAMES_MAX * UINT8_COUNT)
 
+#ifdef CC_FEATURES
+// The number of natives with dedicated opcodes, OP_ARRAY_GET..OP_HASH_GET.
+#define INTRINSIC_COUNT 5
+#endif
+
 
 typedef struct {
   ObjFunction* function;
@@ -26,6 +31,13 @@ typedef struct {
   Table strings;
 
   Obj* objects;
+
+#ifdef CC_FEATURES
+  // Interned names of the natives behind the intrinsic opcodes, and whether
+  // the script has since assigned something else to that global.
+  ObjString* intrinsicNames[INTRINSIC_COUNT];
+  bool intrinsicShadowed[INTRINSIC_COUNT];
+#endif
 } VM;
 
 
@@ -47,7 +59,10 @@ Value pop();
 
 #ifdef CC_FEATURES
 void defineNative(const char* name, NativeFn function);
+void defineNativeSignature(const char* name, NativeFn function,
+                           int minArity, int maxArity, const char* argTypes);
 Value callCallback(Value callback, int argCount, Value* args);
+int intrinsicOpcode(ObjString* name);
 #endif
 
 
@@ -0,0 +1,114 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "workers.h"
+
+// Everything below is guarded by lock.  A job is handed out one task index at
+// a time, the calling thread taking tasks alongside the pool.
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t workReady = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t workDone = PTHREAD_COND_INITIALIZER;
+
+static pthread_t threads[WORKERS_MAX];
+static int threadCount = 0;
+static bool started = false;
+static bool stopping = false;
+
+static WorkerTask currentTask = NULL;
+static void* currentContext = NULL;
+static int jobSize = 0;
+static int nextTask = 0;
+static int tasksLeft = 0;
+
+
+// Called and returns with lock held.
+static void runTasks() {
+  while (nextTask < jobSize) {
+    int index = nextTask++;
+    WorkerTask task = currentTask;
+    void* context = currentContext;
+
+    pthread_mutex_unlock(&lock);
+    task(context, index);
+    pthread_mutex_lock(&lock);
+
+    if (--tasksLeft == 0) pthread_cond_signal(&workDone);
+  }
+}
+
+
+static void* workerMain(void* unused) {
+  pthread_mutex_lock(&lock);
+  for (;;) {
+    while (!stopping && nextTask >= jobSize) {
+      pthread_cond_wait(&workReady, &lock);
+    }
+    if (stopping) break;
+    runTasks();
+  }
+  pthread_mutex_unlock(&lock);
+  return NULL;
+}
+
+
+static int configuredCount() {
+  const char* setting = getenv("CLOX_THREADS");
+  long count = setting != NULL && setting[0] != '\0'
+      ? strtol(setting, NULL, 10)
+      : sysconf(_SC_NPROCESSORS_ONLN);
+  if (count < 1) return 1;
+  return count > WORKERS_MAX ? WORKERS_MAX : (int)count;
+}
+
+
+// The number of threads a job is spread over, counting the calling thread.
+int workerCount() {
+  if (!started) {
+    started = true;
+    stopping = false;
+    int wanted = configuredCount() - 1;
+    while (threadCount < wanted &&
+           pthread_create(&threads[threadCount], NULL, workerMain, NULL) == 0) {
+      threadCount++;
+    }
+  }
+  return threadCount + 1;
+}
+
+
+// Calls task(context, index) once for every index below taskCount, spread
+// over the pool, and returns when all of them have finished.
+void workersRun(WorkerTask task, void* context, int taskCount) {
+  if (workerCount() == 1 || taskCount == 1) {
+    for (int i = 0; i < taskCount; i++) task(context, i);
+    return;
+  }
+
+  pthread_mutex_lock(&lock);
+  currentTask = task;
+  currentContext = context;
+  jobSize = taskCount;
+  nextTask = 0;
+  tasksLeft = taskCount;
+  pthread_cond_broadcast(&workReady);
+
+  runTasks();
+  while (tasksLeft > 0) pthread_cond_wait(&workDone, &lock);
+  pthread_mutex_unlock(&lock);
+}
+
+
+void workersStop() {
+  if (!started) return;
+
+  pthread_mutex_lock(&lock);
+  stopping = true;
+  pthread_cond_broadcast(&workReady);
+  pthread_mutex_unlock(&lock);
+
+  for (int i = 0; i < threadCount; i++) pthread_join(threads[i], NULL);
+  threadCount = 0;
+  started = false;
+}
@@ -0,0 +1,22 @@
+#ifndef clox_workers_h
+#define clox_workers_h
+
+#include "common.h"
+
+// A fixed pool of threads for natives that can split their work into pieces
+// that never touch the VM: nothing allocated, no objects created, no strings
+// interned, no callbacks.  Sorting numbers and strings is the main customer.
+//
+// The pool is one thread per online CPU, or CLOX_THREADS if that is set, up
+// to WORKERS_MAX.  The threads are only started the first time something asks
+// how many there are, and are stopped again by freeVM().
+
+#define WORKERS_MAX 64
+
+typedef void (*WorkerTask)(void* context, int index);
+
+int workerCount();
+void workersRun(WorkerTask task, void* context, int taskCount);
+void workersStop();
+
+#endif